@@ -0,0 +1,409 @@
+/*
+ * Timing harness for the procfs readers of dwmstatus-server. The server
+ * source is compiled in with its main() renamed, so the functions timed
+ * here are the ones the server runs.
+ *
+ *   g++ -std=c++20 -O3 -pthread -DNO_X11 dwmstatus-bench.cpp -o dwmstatus-bench -lfmt -ldl
+ *   dwmstatus-bench cpu [cpus] [iterations]
+ *   dwmstatus-bench top [children] [passes]
+ *   dwmstatus-bench publish [threads] [rounds]
+ *   dwmstatus-bench files [files] [iterations]
+ *
+ * cpu: parse_proc_stat() and cpu_busy_percent() over a synthetic /proc/stat
+ *      with the given number of cpu rows (MAX_CPUS by default)
+ * top: read_top() with the given number of extra sleeping processes (4000 by
+ *      default), one call per refresh, each bounded by TOP_SCAN_BUDGET
+ * publish: the worker to main thread handoff under contention, each thread
+ *      publishes rounds of results through its FieldPublication and the
+ *      shared ResultQueue while the main thread drains and checks them; build
+ *      with -fsanitize=thread -O1 -g to have the handoff race checked
+ * files: read_files_uring() against one pread() per file over the given
+ *      number of open procfs files (R_SIZE by default), the syscalls and time
+ *      one refresh of all of them costs each way
+ */
+
+/* the renamed main() relies on the implicit return only main() has */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main dwmstatus_server_main
+#include "dwmstatus-server.cpp"
+#undef main
+#pragma GCC diagnostic pop
+
+#include <chrono>
+
+/* a result checkable on the consumer side: its round, then filler up to a round-dependent length */
+static constexpr std::size_t PUBLISH_FILL_MIN = 16;
+
+/* read cyclically up to the requested count, the ones missing on this box are skipped */
+static constexpr const char* BENCH_FILES[] = {
+        "/proc/loadavg",
+        "/proc/uptime",
+        "/proc/meminfo",
+        "/proc/stat",
+        "/proc/vmstat",
+        "/proc/pressure/cpu",
+        "/sys/class/thermal/thermal_zone0/temp",
+        "/sys/class/power_supply/BAT0/capacity",
+};
+
+/* function declarations */
+static std::string make_proc_stat(const std::size_t cpus, const std::uint64_t tick);
+static void bench_cpu(const std::size_t cpus, const std::size_t iterations);
+static void bench_top(const std::size_t children, const std::size_t passes);
+static void bench_publish(const std::size_t threads, const std::size_t rounds);
+static void bench_files(const std::size_t files, const std::size_t iterations);
+static void fill_result(FieldBuffer* field_buffer, const std::size_t round);
+static bool check_result(const FieldBuffer* field_buffer, std::size_t* round);
+static std::size_t count_processes();
+static std::size_t parse_count(const char* arg, const std::size_t fallback);
+
+/* function implementations */
+std::string
+make_proc_stat(const std::size_t cpus, const std::uint64_t tick)
+{
+        /* counters in the range a box reaches after months of uptime, advancing with tick */
+        std::string text = fmt::format(
+                               "cpu  {} {} {} {} {} {} {} 0 0 0\n",
+                               4000000000ull + tick * 300, 1000, 900000000ull + tick * 50,
+                               90000000000ull + tick * 1200, 3000000ull + tick, 0, 100000
+                           );
+
+        for(std::size_t i = 0; i < cpus; ++i)
+        {
+                text += fmt::format(
+                            "cpu{} {} {} {} {} {} {} {} 0 0 0\n",
+                            i, 15000000ull + tick * (i % 7), 4, 3500000ull + tick, 350000000ull + tick * 5,
+                            12000ull + (i % 3 == 0 ? tick : 0), 0, 400
+                        );
+        }
+
+        /* the lines after the cpu rows, "intr" is the long one the parser must not walk */
+        text += "intr 123456789";
+        for(int i = 0; i < 512; ++i)
+                text += " 0";
+        text += "\nctxt 987654321\nbtime 1700000000\nprocesses 123456\n";
+
+        return text;
+}
+
+void
+bench_cpu(const std::size_t cpus, const std::size_t iterations)
+{
+        /* two samples alternated, so every iteration computes real deltas */
+        const std::array<std::string, 2> samples = { make_proc_stat(cpus, 0), make_proc_stat(cpus, 100) };
+        if(samples[0].size() > PROC_STAT_READ_SIZE)
+                fmt::print(stderr, "bench_cpu(): {} bytes exceed PROC_STAT_READ_SIZE, rows are cut\n", samples[0].size());
+
+        static CpuTimes times[2];
+        static std::array<std::uint8_t, MAX_CPUS + 1> busy_pct;
+        std::uint64_t sink = 0;
+        std::size_t rows = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < iterations; ++i)
+        {
+                const std::string& text = samples[i & 1];
+                const std::size_t n = std::min(text.size(), PROC_STAT_READ_SIZE);
+
+                rows = parse_proc_stat(text.data(), text.data() + n, &times[i & 1]);
+                cpu_busy_percent(times[(i + 1) & 1], times[i & 1], rows, busy_pct.data());
+                sink += busy_pct[0] + busy_pct[rows - 1];
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        fmt::print(
+            "cpu: {} rows, {} bytes, {} iterations: {} ns per sample (checksum {})\n",
+            rows,
+            samples[0].size(),
+            iterations,
+            ns / std::int64_t(std::max<std::size_t>(iterations, 1)),
+            sink
+        );
+}
+
+void
+bench_top(const std::size_t children, const std::size_t passes)
+{
+        std::vector<pid_t> pids;
+        pids.reserve(children);
+        for(std::size_t i = 0; i < children; ++i)
+        {
+                const pid_t pid = fork();
+                if(pid == 0)
+                {
+                        pause();
+                        _exit(EXIT_SUCCESS);
+                }
+
+                if(pid < 0)
+                {
+                        perror("fork");
+                        break;
+                }
+
+                pids.push_back(pid);
+        }
+
+        /* a pass over /proc takes this many refreshes, the first pass only records the samples */
+        const std::size_t processes = count_processes();
+        const std::size_t refreshes = (processes / TOP_SCAN_BUDGET + 1) * (passes + 1);
+
+        static FieldBuffer field_buffer;
+        std::int64_t total_ns = 0;
+        std::int64_t max_ns = 0;
+        for(std::size_t i = 0; i < refreshes; ++i)
+        {
+                const auto start = std::chrono::steady_clock::now();
+                read_top(&field_buffer);
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+                total_ns += ns;
+                max_ns = std::max(max_ns, ns);
+        }
+
+        for(const pid_t pid : pids)
+                kill(pid, SIGKILL);
+        for(const pid_t pid : pids)
+                waitpid(pid, nullptr, 0);
+
+        fmt::print(
+            "top: {} processes, {} refreshes of at most {}: avg {} us, max {} us per refresh, {} us per pass (\"{}\")\n",
+            processes,
+            refreshes,
+            TOP_SCAN_BUDGET,
+            total_ns / std::int64_t(std::max<std::size_t>(refreshes, 1)) / 1000,
+            max_ns / 1000,
+            total_ns / std::int64_t(passes + 1) / 1000,
+            field_buffer.data
+        );
+}
+
+void
+bench_publish(const std::size_t threads, const std::size_t rounds)
+{
+        /* the main thread stands in for the server loop, the eventfd is only written to */
+        for(std::size_t i = 0; i < pool_results.cells.size(); ++i)
+                pool_results.cells[i].sequence.store(i, std::memory_order_relaxed);
+        pollfds[P_POOL].fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        die(pollfds[P_POOL].fd < 0, "eventfd");
+
+        std::vector<std::thread> producers;
+        const auto start = std::chrono::steady_clock::now();
+        for(std::size_t t = 0; t < threads; ++t)
+        {
+                producers.emplace_back([t, rounds]
+                {
+                        FieldPublication* publication = &builtin_job_states[t].publication;
+                        for(std::size_t round = 1; round <= rounds; ++round)
+                        {
+                                fill_result(publication_back(publication), round);
+                                publication_publish(publication);
+                                publish_result({ &builtin_updates[t], round });
+                        }
+                });
+        }
+
+        std::vector<std::size_t> last_round(threads, 0);
+        std::size_t received = 0;
+        std::size_t torn = 0;
+        std::size_t reordered = 0;
+        PoolResult result;
+        while(received < threads * rounds)
+        {
+                if(!pop_result(&result))
+                {
+                        std::this_thread::yield();
+                        continue;
+                }
+
+                /* the slot may already hold a later round than the queued result, never an older one */
+                const std::size_t t = std::size_t(result.field_update - builtin_updates.data());
+                std::size_t round = 0;
+                if(!check_result(publication_consume(&builtin_job_states[t].publication), &round))
+                        ++torn;
+                else if(round < last_round[t] || round < result.received_us)
+                        ++reordered;
+
+                last_round[t] = std::max(last_round[t], round);
+                ++received;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        for(auto& producer : producers)
+                producer.join();
+        close(pollfds[P_POOL].fd);
+
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        fmt::print(
+            "publish: {} threads, {} results: {} ns per result, {} torn, {} out of order\n",
+            threads,
+            received,
+            ns / std::int64_t(std::max<std::size_t>(received, 1)),
+            torn,
+            reordered
+        );
+}
+
+void
+fill_result(FieldBuffer* field_buffer, const std::size_t round)
+{
+        const auto out = fmt::format_to_n(field_buffer->data, BUFFER_MAX_SIZE, "{}:", round);
+        const std::size_t length = std::min(out.size + PUBLISH_FILL_MIN + round % 64, std::size_t(BUFFER_MAX_SIZE));
+
+        std::fill(field_buffer->data + out.size, field_buffer->data + length, char('a' + round % 26));
+        field_buffer->data[length] = '\0';
+        field_buffer->length = std::uint32_t(length);
+}
+
+bool
+check_result(const FieldBuffer* field_buffer, std::size_t* round)
+{
+        const char* begin = field_buffer->data;
+        const char* end = begin + field_buffer->length;
+        const auto [colon, ec] = std::from_chars(begin, end, *round);
+        if(ec != std::errc() || colon == end || *colon != ':')
+                return false;
+
+        const std::size_t prefix = std::size_t(colon + 1 - begin);
+        if(field_buffer->length != std::min(prefix + PUBLISH_FILL_MIN + *round % 64, std::size_t(BUFFER_MAX_SIZE)))
+                return false;
+
+        return std::all_of(colon + 1, end, [round](const char c) { return c == char('a' + *round % 26); });
+}
+
+void
+bench_files(const std::size_t files, const std::size_t iterations)
+{
+        std::vector<FieldBuffer> buffers(files);
+        std::vector<FieldUpdate> updates;
+        std::vector<FileRead> reads;
+        updates.reserve(files);
+        reads.reserve(files);
+        for(std::size_t i = 0, tried = 0; reads.size() < files && tried < files * std::size(BENCH_FILES); ++tried)
+        {
+                const char* path = BENCH_FILES[tried % std::size(BENCH_FILES)];
+                const int fd = open(path, O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                        continue;
+
+                updates.emplace_back(path, nullptr, &buffers[i++]);
+                reads.push_back({ &updates.back(), fd, 0 });
+        }
+
+        const auto run = [&](const char* name, void (*read_all)(FileRead*, std::size_t))
+        {
+                const std::uint64_t syscalls = stats.read_syscalls;
+                std::uint64_t bytes = 0;
+
+                const auto start = std::chrono::steady_clock::now();
+                for(std::size_t i = 0; i < iterations; ++i)
+                {
+                        read_all(reads.data(), reads.size());
+                        for(const FileRead& r : reads)
+                                bytes += std::uint64_t(std::max<ssize_t>(r.result, 0));
+                }
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                fmt::print(
+                    "files: {:8} {} files, {} iterations: {} us and {} syscalls per refresh, {} bytes per refresh\n",
+                    name,
+                    reads.size(),
+                    iterations,
+                    ns / std::int64_t(std::max<std::size_t>(iterations, 1)) / 1000,
+                    double(stats.read_syscalls - syscalls) / double(std::max<std::size_t>(iterations, 1)),
+                    bytes / std::max<std::size_t>(iterations, 1)
+                );
+        };
+
+        run("pread", [](FileRead* r, const std::size_t count)
+        {
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                        r[i].result = pread(r[i].fd, r[i].field_update->target()->data, BUFFER_MAX_SIZE, 0);
+                        ++stats.read_syscalls;
+                }
+        });
+
+#ifndef NO_IO_URING
+        init_uring();
+        if(uring.fd >= 0)
+                run("io_uring", &read_files_uring);
+        else
+                fmt::print("files: io_uring unavailable, read_files() falls back to pread\n");
+#else
+        fmt::print("files: built with NO_IO_URING\n");
+#endif
+
+        for(const FileRead& r : reads)
+                close(r.fd);
+}
+
+std::size_t
+count_processes()
+{
+        DIR* dir = opendir(PROC_DIR);
+        if(dir == nullptr)
+                return 0;
+
+        std::size_t count = 0;
+        while(const struct dirent* entry = readdir(dir))
+        {
+                if(unsigned(entry->d_name[0] - '0') < 10)
+                        ++count;
+        }
+
+        closedir(dir);
+        return count;
+}
+
+std::size_t
+parse_count(const char* arg, const std::size_t fallback)
+{
+        std::size_t value = fallback;
+        if(arg != nullptr)
+                std::from_chars(arg, arg + strlen(arg), value);
+
+        return value;
+}
+
+int
+main(int argc, char* argv[])
+{
+        const std::string_view mode = argc > 1 ? argv[1] : "";
+        if(mode == "cpu")
+        {
+                const std::size_t cpus = std::min(parse_count(argc > 2 ? argv[2] : nullptr, MAX_CPUS), MAX_CPUS);
+                bench_cpu(cpus, parse_count(argc > 3 ? argv[3] : nullptr, 100000));
+                return EXIT_SUCCESS;
+        }
+
+        if(mode == "top")
+        {
+                bench_top(parse_count(argc > 2 ? argv[2] : nullptr, 4000), parse_count(argc > 3 ? argv[3] : nullptr, 3));
+                return EXIT_SUCCESS;
+        }
+
+        if(mode == "publish")
+        {
+                /* one producer per builtin, the same bound the server's in-flight jobs have */
+                const std::size_t threads = std::min(parse_count(argc > 2 ? argv[2] : nullptr, 8), builtin_updates.size());
+                bench_publish(threads, parse_count(argc > 3 ? argv[3] : nullptr, 200000));
+                return EXIT_SUCCESS;
+        }
+
+        if(mode == "files")
+        {
+                bench_files(parse_count(argc > 2 ? argv[2] : nullptr, R_SIZE), parse_count(argc > 3 ? argv[3] : nullptr, 10000));
+                return EXIT_SUCCESS;
+        }
+
+        fmt::print(
+            stderr,
+            "usage: dwmstatus-bench cpu [cpus] [iterations] | top [children] [passes] | publish [threads] [rounds]"
+            " | files [files] [iterations]\n"
+        );
+        return EXIT_FAILURE;
+}
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <fmt/core.h>
 #include <stdexcept>
 #include <string_view>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#ifdef GENERATED_CONFIG
+#include "dwmstatus-ids.h"  /* written by dwmstatus-gen */
+#endif
 
 static constexpr const char* SOCKET_PATH = "/tmp/dwmstatus.socket";
 
@@ -28,6 +32,17 @@ int main(const int argc, const char* argv[])
         strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
 
         std::uint32_t num;
+#ifdef GENERATED_CONFIG
+        const std::string_view name = argv[1];
+        const auto named = std::find_if(
+                hotkey_ids.begin(),
+                hotkey_ids.end(),
+                [&](const HotkeyId& h) { return h.name == name; }
+        );
+        if(named != hotkey_ids.end())
+                num = named->id;
+        else
+#endif
         try
         {
                 num = std::stoul(argv[1]);
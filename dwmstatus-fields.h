@@ -0,0 +1,97 @@
+#ifndef DWMSTATUS_FIELDS_H
+#define DWMSTATUS_FIELDS_H
+
+/*
+ * Status fields in the order they appear on the bar, shared by
+ * dwmstatus-server and dwmstatus-gen. The three lists must stay parallel.
+ */
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+enum {
+        R_TIME = 0,
+        R_LOAD,
+        R_CPU,
+        R_NET,
+        R_PSI,
+        R_DISK,
+        R_DIO,
+        R_TOP,
+        R_TEMP,
+        R_VOL,
+        R_MIC,
+        R_MEM,
+        R_GOV,
+        R_LANG,
+        R_WTH,
+        R_DATE,
+        R_BAT,
+        R_EXPR1,  /* derived fields, off unless given an expression */
+        R_EXPR2,
+        R_SIZE
+};
+
+/* names used by config files, plugins and the stats output */
+static constexpr std::array<std::string_view, R_SIZE> field_names = {
+        "time", "load", "cpu", "net", "psi", "disk", "dio", "top", "temp", "vol", "mic", "mem", "gov", "lang", "weather", "date", "bat", "expr1", "expr2"
+};
+
+/* enumerator spelling, for generated code */
+static constexpr std::array<std::string_view, R_SIZE> field_enum_names = {
+        "R_TIME", "R_LOAD", "R_CPU", "R_NET", "R_PSI", "R_DISK", "R_DIO", "R_TOP", "R_TEMP", "R_VOL", "R_MIC", "R_MEM", "R_GOV", "R_LANG", "R_WTH", "R_DATE", "R_BAT", "R_EXPR1", "R_EXPR2"
+};
+
+/* slots are either all positional "{}", filled in field order, or all named "{cpu}";
+   fields without a slot are not shown. nullptr if the format is usable */
+constexpr const char*
+format_error(const std::string_view format)
+{
+        std::size_t positional = 0;
+        std::size_t named = 0;
+        std::array<bool, R_SIZE> seen = {};
+
+        for(std::size_t i = 0; i < format.size(); ++i)
+        {
+                if(format[i] == '}')
+                        return "format: } without {";
+
+                if(format[i] != '{')
+                        continue;
+
+                const std::size_t end = format.find('}', i + 1);
+                if(end == std::string_view::npos)
+                        return "format: { without }";
+
+                const std::string_view name = format.substr(i + 1, end - i - 1);
+                if(name.empty())
+                {
+                        ++positional;
+                }
+                else
+                {
+                        const auto field = std::find(field_names.begin(), field_names.end(), name);
+                        if(field == field_names.end())
+                                return "format: unknown field in {}";
+
+                        if(seen[field - field_names.begin()])
+                                return "format: field named twice";
+
+                        seen[field - field_names.begin()] = true;
+                        ++named;
+                }
+
+                i = end;
+        }
+
+        if(positional > 0 && named > 0)
+                return "format: mixes {} and {name} slots";
+
+        if(positional > R_SIZE)
+                return "format: more {} than fields";
+
+        return nullptr;
+}
+
+#endif /* DWMSTATUS_FIELDS_H */
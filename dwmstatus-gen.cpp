@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include "dwmstatus-fields.h"
+
+/*
+ * Turns a declarative config into dwmstatus-config.h, the constexpr tables and
+ * STATUS_LAYOUT dwmstatus-server is built with when GENERATED_CONFIG is defined, and
+ * dwmstatus-ids.h, the hotkey names dwmstatus-client accepts.
+ *
+ *   format <format with a {name} per field shown, or {} slots in field order>
+ *   field <name> shell <min ms> <max ms> <command>
+ *   field <name> file <min ms> <max ms> <path> [parse function]
+ *   field <name> coroutine <min ms> <max ms> <function>
+ *   field <name> builtin <function> [<min ms> <max ms>]
+ *   field <name> expr <decimals> <expression>
+ *   essential <name>
+ *   hotkey <id> <field|quit|refresh|stats|page> [interactive|background]
+ *
+ * Intervals of 0 0 keep a field out of the periodic schedule, fields that
+ * are not mentioned have no updater. Expressions are only copied over,
+ * the server's compile_expression() checks them when it is built.
+ */
+
+/* macros */
+#define DWMSTATUS_NORETURN __attribute__((__noreturn__))
+
+/* global constexpr variables */
+static constexpr std::uint32_t MAX_HOTKEYS = 64;  /* keep in sync with dwmstatus-server */
+static constexpr std::string_view RAW_DELIM = "dwmstatus";
+
+/* enums */
+enum {
+        K_NONE = 0,
+        K_SHELL,
+        K_FILE,
+        K_COROUTINE,
+        K_BUILTIN,
+        K_EXPR,
+        K_SIZE
+};
+
+static constexpr std::array<std::string_view, K_SIZE> kind_tables = {
+        "", "shell_updates", "file_updates", "coroutine_updates", "builtin_updates", "derived_updates"
+};
+
+/* struct definitions */
+struct GenField
+{
+        int kind                      = K_NONE;
+        std::uint32_t min_interval_ms = 0;
+        std::uint32_t max_interval_ms = 0;
+        bool essential                = false;
+        std::uint32_t precision       = 0;  /* decimals of an expression */
+        std::string arg;    /* command, path, function or expression */
+        std::string parse;  /* file post-processing function, optional */
+        std::size_t index   = 0;  /* position in its table */
+};
+
+struct GenHotkey
+{
+        std::uint32_t id;
+        std::string target;
+        bool background;
+};
+
+struct GenConfig
+{
+        std::array<GenField, R_SIZE> fields;
+        std::vector<GenHotkey> hotkeys;
+        std::string status_fmt;
+};
+
+/* function declarations */
+static void fail(const char* path, const std::size_t lineno, const std::string_view why) DWMSTATUS_NORETURN;
+static std::string_view next_token(std::string_view* line);
+static std::string_view rest_of_line(std::string_view line);
+static bool parse_u32(const std::string_view token, std::uint32_t* value);
+static bool is_identifier(const std::string_view token);
+static int find_field(const std::string_view name);
+static const char* parse_line(std::string_view line, GenConfig* config);
+static void parse_file(const char* path, GenConfig* config);
+static std::string raw_string(const std::string_view s);
+static std::string table_ref(const GenConfig& config, const std::string_view target);
+static void write_config_header(const char* path, const char* source, GenConfig* config);
+static void write_ids_header(const char* path, const char* source, const GenConfig& config);
+
+/* function definitions */
+void
+fail(const char* path, const std::size_t lineno, const std::string_view why)
+{
+        if(lineno > 0)
+                fmt::print(stderr, "dwmstatus-gen: {}:{}: {}\n", path, lineno, why);
+        else
+                fmt::print(stderr, "dwmstatus-gen: {}: {}\n", path, why);
+
+        exit(EXIT_FAILURE);
+}
+
+std::string_view
+next_token(std::string_view* line)
+{
+        const std::size_t start = line->find_first_not_of(" \t");
+        if(start == std::string_view::npos)
+        {
+                *line = {};
+                return {};
+        }
+
+        const std::size_t end = std::min(line->find_first_of(" \t", start), line->size());
+        const std::string_view token = line->substr(start, end - start);
+        line->remove_prefix(end);
+
+        return token;
+}
+
+std::string_view
+rest_of_line(const std::string_view line)
+{
+        return line.substr(std::min(line.find_first_not_of(" \t"), line.size()));
+}
+
+bool
+parse_u32(const std::string_view token, std::uint32_t* value)
+{
+        const auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), *value);
+
+        return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+bool
+is_identifier(const std::string_view token)
+{
+        if(token.empty() || (token[0] >= '0' && token[0] <= '9'))
+                return false;
+
+        return std::all_of(token.begin(), token.end(), [](const char c)
+        {
+                return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        });
+}
+
+int
+find_field(const std::string_view name)
+{
+        const auto it = std::find(field_names.begin(), field_names.end(), name);
+
+        return it != field_names.end() ? int(it - field_names.begin()) : -1;
+}
+
+const char*
+parse_line(std::string_view line, GenConfig* config)
+{
+        const std::string_view keyword = next_token(&line);
+        if(keyword.empty() || keyword[0] == '#')
+                return nullptr;
+
+        if(keyword == "format")
+        {
+                config->status_fmt = rest_of_line(line);
+
+                return format_error(config->status_fmt);
+        }
+
+        if(keyword == "essential")
+        {
+                const int f = find_field(next_token(&line));
+                if(f < 0)
+                        return "essential: unknown field";
+
+                config->fields[f].essential = true;
+                return nullptr;
+        }
+
+        if(keyword == "hotkey")
+        {
+                GenHotkey hotkey = { 0, {}, false };
+                if(!parse_u32(next_token(&line), &hotkey.id) || hotkey.id >= MAX_HOTKEYS)
+                        return "hotkey: bad id";
+
+                hotkey.target = next_token(&line);
+                if(find_field(hotkey.target) < 0 && hotkey.target != "quit" && hotkey.target != "refresh" &&
+                   hotkey.target != "stats" && hotkey.target != "page")
+                        return "hotkey: unknown target";
+
+                const std::string_view priority = next_token(&line);
+                if(priority == "background")
+                        hotkey.background = true;
+                else if(!priority.empty() && priority != "interactive")
+                        return "hotkey: unknown priority";
+
+                for(const GenHotkey& h : config->hotkeys)
+                {
+                        if(h.id == hotkey.id)
+                                return "hotkey: id used twice";
+                }
+
+                config->hotkeys.push_back(hotkey);
+                return nullptr;
+        }
+
+        if(keyword != "field")
+                return "unknown keyword";
+
+        const int f = find_field(next_token(&line));
+        if(f < 0)
+                return "field: unknown name";
+
+        GenField& field = config->fields[f];
+        if(field.kind != K_NONE)
+                return "field: defined twice";
+
+        const std::string_view kind = next_token(&line);
+        if(kind == "off")
+                return nullptr;
+
+        if(kind == "builtin")
+        {
+                field.kind = K_BUILTIN;
+                field.arg = next_token(&line);
+                if(!is_identifier(field.arg))
+                        return "field: bad function name";
+
+                /* toggles run only on request, readers like read_cpu are polled */
+                const std::string_view min = next_token(&line);
+                if(min.empty())
+                        return nullptr;
+
+                if(!parse_u32(min, &field.min_interval_ms) ||
+                   !parse_u32(next_token(&line), &field.max_interval_ms) ||
+                   field.min_interval_ms > field.max_interval_ms ||
+                   (field.min_interval_ms == 0) != (field.max_interval_ms == 0))
+                        return "field: bad intervals";
+
+                return nullptr;
+        }
+
+        if(kind == "expr")
+        {
+                /* not polled, evaluated when an input changes */
+                field.kind = K_EXPR;
+                if(!parse_u32(next_token(&line), &field.precision) || field.precision > 6)
+                        return "field: bad decimals";
+
+                field.arg = rest_of_line(line);
+                return field.arg.empty() ? "field: missing expression" : nullptr;
+        }
+
+        if(kind == "shell")
+                field.kind = K_SHELL;
+        else if(kind == "file")
+                field.kind = K_FILE;
+        else if(kind == "coroutine")
+                field.kind = K_COROUTINE;
+        else
+                return "field: unknown kind";
+
+        if(!parse_u32(next_token(&line), &field.min_interval_ms) ||
+           !parse_u32(next_token(&line), &field.max_interval_ms) ||
+           field.min_interval_ms > field.max_interval_ms ||
+           (field.min_interval_ms == 0) != (field.max_interval_ms == 0))
+                return "field: bad intervals";
+
+        if(field.kind == K_SHELL)
+        {
+                field.arg = rest_of_line(line);
+                return field.arg.empty() ? "field: missing command" : nullptr;
+        }
+
+        field.arg = next_token(&line);
+        if(field.kind == K_COROUTINE)
+                return is_identifier(field.arg) ? nullptr : "field: bad function name";
+
+        if(field.arg.empty())
+                return "field: missing path";
+
+        field.parse = next_token(&line);
+        if(!field.parse.empty() && !is_identifier(field.parse))
+                return "field: bad parse function name";
+
+        return nullptr;
+}
+
+void
+parse_file(const char* path, GenConfig* config)
+{
+        FILE* fp = fopen(path, "re");
+        if(fp == nullptr)
+        {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+
+        char* line = nullptr;
+        std::size_t cap = 0;
+        std::size_t lineno = 0;
+
+        ssize_t len;
+        while((len = getline(&line, &cap, fp)) >= 0)
+        {
+                ++lineno;
+                if(len > 0 && line[len - 1] == '\n')
+                        line[--len] = '\0';
+
+                const char* error = parse_line(std::string_view(line, len), config);
+                if(error != nullptr)
+                        fail(path, lineno, error);
+        }
+
+        free(line);
+        fclose(fp);
+
+        if(config->status_fmt.empty())
+                fail(path, 0, "missing format");
+}
+
+std::string
+raw_string(const std::string_view s)
+{
+        /* commands are full of quotes and backslashes, keep them verbatim */
+        if(s.find(fmt::format("){}\"", RAW_DELIM)) != std::string_view::npos)
+                fail("raw_string", 0, "string contains the raw string delimiter");
+
+        return fmt::format("R\"{}({}){}\"", RAW_DELIM, s, RAW_DELIM);
+}
+
+std::string
+table_ref(const GenConfig& config, const std::string_view target)
+{
+        if(target == "refresh")
+                return "&meta_updates[0]";
+        if(target == "quit")
+                return "&meta_updates[1]";
+        if(target == "stats")
+                return "&meta_updates[2]";
+        if(target == "page")
+                return "&meta_updates[3]";
+
+        const GenField& field = config.fields[find_field(target)];
+
+        return fmt::format("&{}[{}]", kind_tables[field.kind], field.index);
+}
+
+void
+write_config_header(const char* path, const char* source, GenConfig* config)
+{
+        for(const GenHotkey& hotkey : config->hotkeys)
+        {
+                const int f = find_field(hotkey.target);
+                if(f >= 0 && config->fields[f].kind == K_NONE)
+                        fail(source, 0, fmt::format("hotkey {} targets field {}, which has no updater", hotkey.id, hotkey.target));
+        }
+
+        std::string out = fmt::format("/* generated by dwmstatus-gen from {}, do not edit */\n\n", source);
+        out += fmt::format("static constexpr StatusLayout STATUS_LAYOUT = layout_from_format({});\n", raw_string(config->status_fmt));
+
+        /* derived_updates refers to these by position, both are in field order */
+        std::string programs;
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                const GenField& field = config->fields[f];
+                if(field.kind == K_EXPR)
+                        programs += fmt::format("{}        compile_expression({}, {})", programs.empty() ? "" : ",\n", raw_string(field.arg), field.precision);
+        }
+
+        if(programs.empty())
+                out += "\nstatic constexpr std::array<ExprProgram, 0> derived_programs = {};\n";
+        else
+                out += fmt::format("\nstatic constexpr auto derived_programs = std::to_array<ExprProgram>({{\n{}\n}});\n", programs);
+
+        /* one table per kind, in field order */
+        for(int kind = K_SHELL; kind < K_SIZE; ++kind)
+        {
+                std::string rows;
+                std::size_t count = 0;
+
+                for(std::size_t f = 0; f < R_SIZE; ++f)
+                {
+                        GenField& field = config->fields[f];
+                        if(field.kind != kind)
+                                continue;
+
+                        field.index = count++;
+
+                        std::string row;
+                        switch(kind)
+                        {
+                        case K_SHELL:
+                                row = raw_string(field.arg);
+                                break;
+                        case K_FILE:
+                                row = fmt::format("{}, {}", raw_string(field.arg), field.parse.empty() ? "nullptr" : "&" + field.parse);
+                                break;
+                        case K_EXPR:
+                                row = fmt::format("&derived_programs[{}]", field.index);
+                                break;
+                        default:
+                                row = "&" + field.arg;
+                                break;
+                        }
+
+                        rows += fmt::format("{}        {{ {}, &field_buffers[{}] }}", count > 1 ? ",\n" : "", row, field_enum_names[f]);
+                }
+
+                if(count == 0)
+                        out += fmt::format("\nstatic constexpr std::array<FieldUpdate, 0> {} = {{}};\n", kind_tables[kind]);
+                else
+                        out += fmt::format("\nstatic constexpr std::array {} = std::to_array<FieldUpdate>({{\n{}\n}});\n", kind_tables[kind], rows);
+        }
+
+        out += "\nstatic constexpr std::array meta_updates = std::to_array<FieldUpdate>({\n"
+               "        &refresh_polled,\n"
+               "        &terminator,\n"
+               "        &print_stats,\n"
+               "        &next_page\n"
+               "});\n";
+
+        std::uint32_t ids = 0;
+        for(const GenHotkey& hotkey : config->hotkeys)
+                ids = std::max(ids, hotkey.id + 1);
+
+        if(ids == 0)
+        {
+                out += "\nstatic constexpr std::array<RealTimeUpdate, 0> real_time_updates = {};\n";
+        }
+        else
+        {
+                out += "\nstatic constexpr auto real_time_updates = std::to_array<RealTimeUpdate>({\n";
+                for(std::uint32_t id = 0; id < ids; ++id)
+                {
+                        const auto hotkey = std::find_if(config->hotkeys.begin(), config->hotkeys.end(), [&](const GenHotkey& h) { return h.id == id; });
+                        const std::string ref = hotkey != config->hotkeys.end() ? table_ref(*config, hotkey->target) : "nullptr";
+                        const bool background = hotkey != config->hotkeys.end() && hotkey->background;
+
+                        out += fmt::format(
+                                   "        {{ {}, RealTimeUpdate::{} }}{}  /* {} */\n",
+                                   ref,
+                                   background ? "Background" : "Interactive",
+                                   id + 1 < ids ? "," : "",
+                                   id
+                               );
+                }
+                out += "});\n";
+        }
+
+        std::string periodic;
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                const GenField& field = config->fields[f];
+                if(field.kind == K_NONE || field.min_interval_ms == 0)
+                        continue;
+
+                periodic += fmt::format(
+                                "{}        {{ {}, {}, {}, {} }}",
+                                periodic.empty() ? "" : ",\n",
+                                table_ref(*config, field_names[f]),
+                                field.min_interval_ms,
+                                field.max_interval_ms,
+                                field.essential ? "true" : "false"
+                            );
+        }
+
+        if(periodic.empty())
+                out += "\nstatic constexpr std::array<PeriodicUpdate, 0> periodic_updates = {};\n";
+        else
+                out += fmt::format("\nstatic constexpr auto periodic_updates = std::to_array<PeriodicUpdate>({{\n{}\n}});\n", periodic);
+
+        FILE* fp = fopen(path, "we");
+        if(fp == nullptr || fwrite(out.data(), 1, out.size(), fp) != out.size() || fclose(fp) != 0)
+        {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+}
+
+void
+write_ids_header(const char* path, const char* source, const GenConfig& config)
+{
+        std::string out = fmt::format("/* generated by dwmstatus-gen from {}, do not edit */\n\n", source);
+        out += "#ifndef DWMSTATUS_IDS_H\n"
+               "#define DWMSTATUS_IDS_H\n\n"
+               "#include <array>\n"
+               "#include <cstdint>\n"
+               "#include <string_view>\n\n"
+               "struct HotkeyId\n"
+               "{\n"
+               "        std::string_view name;\n"
+               "        std::uint32_t id;\n"
+               "};\n\n";
+
+        /* the first id bound to a target gets its name */
+        std::vector<std::string_view> named;
+        std::string rows;
+        for(const GenHotkey& hotkey : config.hotkeys)
+        {
+                if(std::find(named.begin(), named.end(), hotkey.target) != named.end())
+                        continue;
+
+                named.push_back(hotkey.target);
+                rows += fmt::format("        {{ \"{}\", {} }},\n", hotkey.target, hotkey.id);
+        }
+
+        out += fmt::format("static constexpr std::array<HotkeyId, {}> hotkey_ids = {{{{\n{}}}}};\n", named.size(), rows);
+        out += "\n#endif /* DWMSTATUS_IDS_H */\n";
+
+        FILE* fp = fopen(path, "we");
+        if(fp == nullptr || fwrite(out.data(), 1, out.size(), fp) != out.size() || fclose(fp) != 0)
+        {
+                perror(path);
+                exit(EXIT_FAILURE);
+        }
+}
+
+int
+main(const int argc, const char* argv[])
+{
+        if(argc != 4)
+        {
+                fmt::print(stderr, "Usage: dwmstatus-gen <config> <dwmstatus-config.h> <dwmstatus-ids.h>\n");
+                return EXIT_FAILURE;
+        }
+
+        GenConfig config;
+        parse_file(argv[1], &config);
+        write_config_header(argv[2], argv[1], &config);
+        write_ids_header(argv[3], argv[1], config);
+}
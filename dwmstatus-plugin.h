@@ -0,0 +1,59 @@
+#ifndef DWMSTATUS_PLUGIN_H
+#define DWMSTATUS_PLUGIN_H
+
+/*
+ * C ABI for builtin updaters loaded by dwmstatus-server at startup from
+ * the shared objects in $HOME/.local/lib/dwmstatus/plugins.
+ *
+ * A plugin exports dwmstatus_plugin_entry(), returning a descriptor that
+ * stays valid until the plugin is unloaded. The plugin takes over the
+ * status field named by `field` (one of the names in the server's
+ * field_names table, e.g. "weather") and is refreshed every `interval_ms`
+ * and whenever the fd returned by `pollfd` becomes readable.
+ *
+ * All callbacks run on the server's main thread and must not block.
+ */
+
+#include <stdint.h>
+
+#define DWMSTATUS_PLUGIN_ABI_VERSION 1
+#define DWMSTATUS_BUFFER_MAX_SIZE    255
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* same layout as the server's FieldBuffer */
+struct dwmstatus_field_buffer {
+        uint32_t length;
+        char data[DWMSTATUS_BUFFER_MAX_SIZE + 1];
+};
+
+struct dwmstatus_plugin {
+        uint32_t abi_version;   /* DWMSTATUS_PLUGIN_ABI_VERSION */
+        const char* name;
+        const char* field;
+        uint32_t interval_ms;   /* 0 to refresh only on pollfd events */
+
+        /* returns the plugin state passed to the other callbacks, NULL on failure */
+        void* (*init)(void);
+
+        /* fills the buffer, length excludes the terminating NUL; returns 0 on success */
+        int (*update)(void* state, struct dwmstatus_field_buffer* field_buffer);
+
+        /* optional: fd to watch for readability, or -1; dropped once it hangs up or is closed */
+        int (*pollfd)(void* state);
+
+        /* optional */
+        void (*teardown)(void* state);
+};
+
+typedef const struct dwmstatus_plugin* (*dwmstatus_plugin_entry_fn)(void);
+
+const struct dwmstatus_plugin* dwmstatus_plugin_entry(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DWMSTATUS_PLUGIN_H */
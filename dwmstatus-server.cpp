@@ -1,13 +1,62 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <coroutine>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <span>
+#include <string>
+#include <thread>
 #include <tuple>
+#include <utility>
+#include <vector>
 #include <fmt/core.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <netdb.h>
+#include <net/if.h>
 #include <unistd.h>
 #include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/timerfd.h>
 #include <sys/un.h>
 #include <sys/wait.h>
+#ifndef NO_IO_URING
+#include <linux/io_uring.h>
+#endif
+#include "dwmstatus-fields.h"
+#include "dwmstatus-plugin.h"
 #ifndef NO_X11
 #include <X11/Xlib.h>
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/scrnsaver.h>
+#ifndef NO_XFT
+#include <X11/Xft/Xft.h>
+#endif
+#else
+#ifndef NO_XFT
+#define NO_XFT  /* glyph metrics need a display */
+#endif
 #endif
 
 /* macros */
@@ -18,25 +67,96 @@
 
 /* enums */
 enum {
-        R_TIME = 0,
-        R_LOAD,
-        R_TEMP,
-        R_VOL,
-        R_MIC,
-        R_MEM,
-        R_GOV,
-        R_LANG,
-        R_WTH,
-        R_DATE,
-        R_BAT,
-        R_SIZE
+        P_SOCK = 0,
+        P_X,
+        P_CLOCK,
+        P_TZ,
+        P_POOL,
+        P_CONFIG,
+        P_NETLINK,
+        P_PSI_CPU,
+        P_PSI_MEMORY,
+        P_PSI_IO,
+        P_SIZE  /* followed by MAX_CORO_WAITERS coroutine waiter slots, then MAX_PLUGINS plugin slots */
 };
 
 /* global constexpr variables */
 static constexpr int BUFFER_MAX_SIZE         = 255;
-static constexpr int ROOT_BUFFER_MAX_SIZE    = R_SIZE * BUFFER_MAX_SIZE;
+static constexpr std::size_t RENDER_LITERALS_SIZE         = 256;  /* separators, prefixes and suffixes together */
+static constexpr std::uint32_t ALL_FIELDS                  = (1u << R_SIZE) - 1;
+static constexpr std::uint32_t PAGE_ROTATE_MS              = 0;    /* 0: pages change only on the hotkey */
+static constexpr const char* BAR_FONT        = "monospace:size=10";  /* the font dwm draws the status with */
+static constexpr std::uint32_t STATUS_WIDTH_PX             = 0;    /* pixels dwm leaves for the status, 0: no budget */
+static constexpr std::size_t GLYPH_CACHE_SIZE              = 512;  /* non-ASCII glyphs, power of two */
+static constexpr bool STATUS2D_COLORS                      = true; /* dwm has the status2d patch, false drops threshold_rules */
+static constexpr std::size_t STYLE_ESCAPE_SIZE             = 16;   /* "^c#rrggbb^" before a field and "^d^" after it */
+static constexpr const char* STYLE_RESET     = "^d^";
+static constexpr std::size_t MAX_SPARKLINES                = 4;
+static constexpr std::size_t SPARKLINE_SAMPLES             = 16;   /* one glyph per sample */
+static constexpr std::size_t SPARKLINE_SIZE                = 1 + SPARKLINE_SAMPLES * 3;  /* a space, then 3-byte block glyphs */
+static constexpr std::size_t MAX_WINDOWS                   = 8;
+static constexpr std::size_t WINDOW_SAMPLES                = 256;  /* per window, the oldest sample is dropped when full */
+static constexpr std::size_t EXPR_MAX_OPS                  = 32;
+static constexpr std::size_t EXPR_STACK_SIZE               = 8;
+static constexpr int ROOT_BUFFER_MAX_SIZE    = R_SIZE * (BUFFER_MAX_SIZE + STYLE_ESCAPE_SIZE) + MAX_SPARKLINES * SPARKLINE_SIZE +
+                                               RENDER_LITERALS_SIZE;
 static constexpr const char* SOCKET_PATH     = "/tmp/dwmstatus.socket";
-static constexpr std::string_view STATUS_FMT = "[{} |{} |{} |{} |{} |{} |{} |{} |{} |{} |{}]";
+static constexpr const char* AC_ONLINE_PATH  = "/sys/class/power_supply/AC/online";
+static constexpr std::uint32_t BATTERY_INTERVAL_MULTIPLIER = 3;    /* stretch adaptive intervals on battery, fixed ones keep their rate */
+static constexpr std::uint32_t TICK_MS                     = 1000; /* periodic deadlines are aligned to this */
+static constexpr unsigned long TIMER_SLACK_NS              = 50'000'000;
+static constexpr std::uint32_t BLANK_CHECK_MS              = 5000; /* DPMS has no events, re-queried at most this often */
+static constexpr std::uint64_t RESUME_THRESHOLD_MS         = 1000; /* boottime drift that counts as a suspend */
+static constexpr std::uint64_t BACKGROUND_BUDGET_MS        = 50;   /* per loop iteration, for background requests and again for due fields */
+static constexpr std::uint64_t INTERACTIVE_SLO_US          = 50'000;
+static constexpr std::size_t REQUEST_QUEUE_SIZE            = 64;
+static constexpr std::size_t LATENCY_SAMPLES               = 512;
+static constexpr std::size_t POOL_WORKERS                  = 2;
+static constexpr std::size_t POOL_RESULTS_SIZE             = 64;   /* power of two */
+static constexpr unsigned URING_ENTRIES                    = 16;
+static constexpr std::size_t MAX_CORO_WAITERS              = 16;   /* fds/timers coroutines can wait on at once */
+static constexpr std::size_t MAX_PLUGINS                   = 8;
+static constexpr std::size_t PLUGIN_POLL_BASE              = P_SIZE + MAX_CORO_WAITERS;
+static constexpr const char* PLUGIN_DIR      = ".local/lib/dwmstatus/plugins";  /* relative to $HOME */
+static constexpr std::uint64_t RESOLVE_POLL_MS             = 20;
+static constexpr std::uint64_t REAP_POLL_MS                = 20;   /* child exit polling when pidfd_open() is missing */
+static constexpr std::uint64_t WEATHER_TIMEOUT_MS          = 5000;
+static constexpr std::uint64_t TEMP_TIMEOUT_MS             = 2000;
+static constexpr const char* WEATHER_HOST    = "wttr.in";
+static constexpr const char* WEATHER_PATH    = "/Bucharest?format=1";
+static constexpr const char* TEMP_CMD        = R"(sensors | grep -F "Core 0" | awk '{print $3}' | cut -c2-5)";
+static constexpr const char* LOADAVG_PATH    = "/proc/loadavg";
+static constexpr const char* BATTERY_PATH    = "/sys/class/power_supply/BAT0/capacity";
+static constexpr const char* PROC_STAT_PATH  = "/proc/stat";
+static constexpr std::size_t MAX_CPUS                      = 256;
+static constexpr std::size_t PROC_STAT_READ_SIZE           = 32768;  /* the cpu lines of MAX_CPUS cores */
+static constexpr const char* NET_DEV_PATH    = "/proc/net/dev";
+static constexpr std::string_view NET_INTERFACES = "";  /* space separated; empty: every link that is up, except loopback */
+static constexpr std::size_t MAX_NET_LINKS                 = 8;    /* shown at once */
+static constexpr std::size_t NET_DEV_READ_SIZE             = 16384;
+static constexpr std::string_view DISK_MOUNTS = "/";     /* space separated mountpoints whose free space is shown */
+static constexpr std::string_view DIO_DEVICES = "";      /* space separated block devices; empty: the ones under DISK_MOUNTS */
+static constexpr const char* DISKSTATS_PATH  = "/proc/diskstats";
+static constexpr const char* MOUNTINFO_PATH  = "/proc/self/mountinfo";
+static constexpr std::size_t MAX_BLOCK_DEVICES             = 8;
+static constexpr std::size_t DISKSTATS_READ_SIZE           = 16384;
+static constexpr const char* PROC_DIR        = "/proc";
+static constexpr std::size_t TOP_SCAN_BUDGET               = 512;    /* processes sampled per refresh */
+static constexpr std::size_t TOP_TABLE_SIZE                = 16384;  /* pid slots, power of two */
+static constexpr std::size_t TOP_MAX_PIDS                  = TOP_TABLE_SIZE * 3 / 4;
+static constexpr std::size_t GETDENTS_BUFFER_SIZE          = 32768;
+static constexpr const char* PSI_TRIGGER     = "some 150000 2000000";  /* 150ms stalled within 2s, unprivileged needs a 2s multiple */
+static constexpr std::uint64_t PSI_RECHECK_MS              = 2000;   /* re-read while the averages settle after a trigger */
+static constexpr std::uint64_t PSI_SETTLE_MS               = 30000;
+static constexpr std::uint64_t PSI_FALLBACK_MS             = 10000;  /* polling interval when no trigger could be registered */
+static constexpr std::array<const char*, 3> PSI_PATHS = {
+        "/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io"  /* in P_PSI_* order */
+};
+static constexpr const char* ZONEINFO_DIR    = "/etc";
+static constexpr const char* ZONEINFO_NAME   = "localtime";
+static constexpr const char* CONFIG_DIR      = ".config/dwmstatus";  /* relative to $HOME */
+static constexpr const char* CONFIG_NAME     = "config";
+static constexpr std::size_t MAX_HOTKEYS                   = 64;
 
 /* struct definitions */
 struct FieldBuffer
@@ -45,17 +165,112 @@ struct FieldBuffer
         char data[BUFFER_MAX_SIZE + 1] = {};
 };
 
+template<typename T>
+struct TaskResult
+{
+        T value = {};
+
+        void return_value(T v) { value = std::move(v); }
+        T take() { return std::move(value); }
+};
+
+template<>
+struct TaskResult<void>
+{
+        void return_void() {}
+        void take() {}
+};
+
+/* lazily started coroutine, awaiting it runs it and resumes the awaiter when it finishes */
+template<typename T = void>
+struct Task
+{
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(Handle h) noexcept
+                {
+                        const auto continuation = h.promise().continuation;
+                        return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+        };
+
+        struct promise_type : TaskResult<T> {
+                std::coroutine_handle<> continuation;
+
+                Task get_return_object() { return Task(Handle::from_promise(*this)); }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                FinalAwaiter final_suspend() noexcept { return {}; }
+                void unhandled_exception() { std::terminate(); }
+        };
+
+        Task() = default;
+        explicit Task(Handle h) : handle(h) {}
+        Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+        Task& operator=(Task&& other) noexcept
+        {
+                if(this != &other)
+                {
+                        if(handle)
+                                handle.destroy();
+                        handle = std::exchange(other.handle, {});
+                }
+                return *this;
+        }
+        ~Task()
+        {
+                if(handle)
+                        handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter)
+        {
+                handle.promise().continuation = awaiter;
+                return handle;
+        }
+        T await_resume() { return handle.promise().take(); }
+
+        Handle handle;
+};
+
+/* suspends until fd has events or the deadline passes, resumes with whether the fd became ready */
+struct IoAwaiter
+{
+        int fd;                     /* -1 for a plain timer */
+        short events;
+        std::uint64_t deadline_ms;  /* UINT64_MAX for none */
+        bool ready = false;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const noexcept { return ready; }
+};
+
+struct ExprProgram;
+
 struct FieldUpdate
 {
         enum Type {
                 Shell = 0,
                 Builtin,
-                Meta
+                Meta,
+                File,
+                Coroutine,
+                Expr
         };
 
         constexpr FieldUpdate(const char* command, FieldBuffer* field_buffer);
         constexpr FieldUpdate(void (*fptr)(FieldBuffer*), FieldBuffer* field_buffer);
         constexpr FieldUpdate(void (*fptr)());
+        constexpr FieldUpdate(const char* path, void (*parse)(FieldBuffer*), FieldBuffer* field_buffer);
+        constexpr FieldUpdate(Task<> (*coro)(FieldBuffer*), FieldBuffer* field_buffer);
+        constexpr FieldUpdate(const ExprProgram* program, FieldBuffer* field_buffer);
+
+        constexpr FieldBuffer* target() const;
 
         struct ShellArgs {
                 const char* command;
@@ -71,11 +286,30 @@ struct FieldUpdate
                 void (*fptr)();
         };
 
+        struct FileArgs {
+                const char* path;
+                void (*parse)(FieldBuffer*);  /* optional, trims the raw contents */
+                FieldBuffer* field_buffer;
+        };
+
+        struct CoroutineArgs {
+                Task<> (*coro)(FieldBuffer*);
+                FieldBuffer* field_buffer;
+        };
+
+        struct ExprArgs {
+                const ExprProgram* program;
+                FieldBuffer* field_buffer;
+        };
+
         int type;
         union {
                 ShellArgs   shell;
                 BuiltinArgs builtin;
                 MetaArgs    meta;
+                FileArgs    file;
+                CoroutineArgs coroutine;
+                ExprArgs    expr;
         } args;
 };
 
@@ -99,319 +333,5317 @@ constexpr FieldUpdate::FieldUpdate(void (*fptr)())
         args.meta.fptr = fptr;
 }
 
-/* template function declarations */
-template<const auto& updates, std::size_t... indexes>
-static void run_meta_update();
+constexpr FieldUpdate::FieldUpdate(const char* path, void (*parse)(FieldBuffer*), FieldBuffer* field_buffer)
+{
+        type                   = Type::File;
+        args.file.path         = path;
+        args.file.parse        = parse;
+        args.file.field_buffer = field_buffer;
+}
 
-/* function declarations */
-static void die(const bool cond, const char* why);
-static ssize_t read_all(const int fd, void* buffer, const size_t nbytes);
-static void create_child(const char* cmd, const int pipe_fds[2]);
-static int get_named_socket();
-static void perror_exit(const char* why) DWMSTATUS_NORETURN;
-static int read_cmd_output(const char* cmd, FieldBuffer* field_buffer);
-static void run_update(const FieldUpdate* field_update);
-static void toggle_lang(FieldBuffer* field_buffer);
-static void toggle_cpu_gov(FieldBuffer* field_buffer);
-static void toggle_mic(FieldBuffer* field_buffer);
-static void terminator();
-static void init_signals();
-static void init_x();
-static void init_statusbar();
-static void update_screen();
-static void handle_received(const std::uint32_t id);
-static void cleanup_and_exit(const int sig) DWMSTATUS_NORETURN;
-static void run();
+constexpr FieldUpdate::FieldUpdate(Task<> (*coro)(FieldBuffer*), FieldBuffer* field_buffer)
+{
+        type                        = Type::Coroutine;
+        args.coroutine.coro         = coro;
+        args.coroutine.field_buffer = field_buffer;
+}
 
-/* global variables */
-static std::array<FieldBuffer, R_SIZE> field_buffers = {};
-static bool running = true;
-#ifndef NO_X11
-static Display* dpy = nullptr;
-static int screen;
-static Window root;
-#endif
+constexpr FieldUpdate::FieldUpdate(const ExprProgram* program, FieldBuffer* field_buffer)
+{
+        type                   = Type::Expr;
+        args.expr.program      = program;
+        args.expr.field_buffer = field_buffer;
+}
 
-/* field configs */
-static constexpr std::array shell_updates = std::to_array<FieldUpdate>({
-        {       /* time */
-                R"(date +%H:%M:%S)",        /* shell command */
-                &field_buffers[R_TIME]      /* reference to root buffer */
-        },
-        {       /* sys load*/
-                R"(uptime | grep -wo "average: .*," | cut --delimiter=' ' -f2 | head -c4)",
-                &field_buffers[R_LOAD]
-        },
-        {       /* cpu temp*/
-                R"(sensors | grep -F "Core 0" | awk '{print $3}' | cut -c2-5)",
-                &field_buffers[R_TEMP]
-        },
-        {       /* volume */
-                R"(amixer sget Master | tail -n1 | get-from-to '[' ']' '--amixer')",
-                &field_buffers[R_VOL]
-        },
-        {       /* memory usage */
-                R"(xss-get-mem)",
-                &field_buffers[R_MEM]
-        },
-        {       /* date */
-                R"(date "+%d.%m.%Y")",
-                &field_buffers[R_DATE]
-        },
-        {       /* weather */
-                R"(curl --max-time 0.5 wttr.in/Bucharest?format=1 2>/dev/null | get-from '+')",
-                &field_buffers[R_WTH]
-        },
-        {       /* weather */
-                R"(cat /sys/class/power_supply/BAT0/capacity)",
-                &field_buffers[R_BAT]
+constexpr FieldBuffer*
+FieldUpdate::target() const
+{
+        switch(type)
+        {
+        case Type::Shell:   return args.shell.field_buffer;
+        case Type::Builtin: return args.builtin.field_buffer;
+        case Type::File:    return args.file.field_buffer;
+        case Type::Coroutine: return args.coroutine.field_buffer;
+        case Type::Expr:    return args.expr.field_buffer;
+        default:            return nullptr;
         }
-});
+}
 
-static constexpr std::array builtin_updates = std::to_array<FieldUpdate>({
-       /* pointer to function   reference to root buffer */
-        { &toggle_lang,         &field_buffers[R_LANG] },
-        { &toggle_cpu_gov,      &field_buffers[R_GOV]  },
-        { &toggle_mic,          &field_buffers[R_MIC]  }
-});
+struct CoroWaiter
+{
+        IoAwaiter* awaiter = nullptr;
+        std::coroutine_handle<> handle;
+};
 
-static constexpr std::array meta_updates = std::to_array<FieldUpdate>({
-     /* pointer to function */
-        &run_meta_update<shell_updates, 0, 1, 2, 4, 7>,
-        &terminator
-});
+struct CoroutineState
+{
+        Task<> task;
+        FieldBuffer scratch;  /* the coroutine writes here, applied to the field when it finishes */
+        bool running              = false;
+        std::uint32_t reruns      = 0;
+        std::uint64_t received_us = 0;
+};
 
-static constexpr auto real_time_updates = std::to_array<const FieldUpdate*>({
-        &meta_updates[1],    /* 0 */
-        &shell_updates[3],   /* 1 */
-        &shell_updates[6],   /* 2 */
-        &builtin_updates[0], /* 3 */
-        &builtin_updates[1], /* 4 */
-        &builtin_updates[2], /* 5 */
-        &meta_updates[0]     /* 6 */
-});
+struct Plugin
+{
+        void* dl_handle                = nullptr;
+        const dwmstatus_plugin* desc   = nullptr;
+        void* state                    = nullptr;
+        int field                      = -1;
+        std::uint64_t deadline_ms      = UINT64_MAX;
+        std::uint64_t updates          = 0;
+        std::uint64_t total_us         = 0;
+        std::uint64_t max_us           = 0;
+};
 
-/* template function definitions */
-template<const auto& updates, std::size_t... indexes>
-void
-run_meta_update()
+struct FileRead
 {
-        (run_update(&updates[indexes]), ...);
-}
+        const FieldUpdate* field_update;
+        int fd;
+        ssize_t result;
+};
 
-/* function definitions */
-void
-die(const bool cond, const char* why)
+#ifndef NO_IO_URING
+struct Uring
 {
-        if(cond)
-                perror_exit(why);
-}
+        int fd = -1;
+        unsigned* sq_tail;
+        unsigned* sq_mask;
+        unsigned* sq_array;
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned* cq_mask;
+        struct io_uring_sqe* sqes;
+        struct io_uring_cqe* cqes;
+};
+#endif
 
-ssize_t
-read_all(const int fd, void* buffer, const size_t nbytes)
+struct PeriodicUpdate
 {
-        char* buf = (char*)buffer;
-        size_t read_so_far = 0;
+        const FieldUpdate* field_update;
+        std::uint32_t min_interval_ms;
+        std::uint32_t max_interval_ms;
+        bool essential;  /* keep refreshing while the screen is blanked */
+};
 
-        while(read_so_far < nbytes)
-        {
-                const ssize_t rc = read(fd, buf + read_so_far, nbytes - read_so_far);
-                if(rc < 0)
-                        return rc;
+struct RealTimeUpdate
+{
+        enum Priority {
+                Interactive = 0,
+                Background
+        };
 
-                if(rc == 0)
-                        break;
+        const FieldUpdate* field_update;
+        int priority;
+};
 
-                read_so_far += rc;
-        }
+struct PendingRequest
+{
+        std::uint32_t id;
+        std::uint64_t received_us;
+};
 
-        return read_so_far;
-}
+struct RequestQueue
+{
+        std::array<PendingRequest, REQUEST_QUEUE_SIZE> items = {};
+        std::size_t head  = 0;
+        std::size_t count = 0;
+};
 
-void
-create_child(const char* cmd, const int pipe_fds[2])
+struct PoolJob
 {
-        const pid_t child_pid = fork();
-        die(child_pid < 0, "fork");
+        const FieldUpdate* field_update;
+        std::uint64_t received_us;  /* non-zero when an interactive request waits on the result */
+};
 
-        if(child_pid == 0)
-        {
-                int rc = close(pipe_fds[0]);
-                if(rc < 0)
-                        exit(EXIT_FAILURE);
+struct PoolResult
+{
+        const FieldUpdate* field_update;
+        std::uint64_t received_us;
+};
 
-                rc = dup2(pipe_fds[1], STDOUT_FILENO);
-                if(rc < 0)
-                        exit(EXIT_FAILURE);
+/* triple buffer: the producer never waits and the consumer only ever sees fully written fields */
+struct FieldPublication
+{
+        static constexpr std::uint8_t INDEX_MASK = 0x3;
+        static constexpr std::uint8_t DIRTY      = 0x4;
 
-                const char* new_argv[] = SHCMD(cmd);
-                execv(new_argv[0], (char**)new_argv);
-                exit(EXIT_FAILURE);
-        }
+        std::array<FieldBuffer, 3> slots = {};
+        std::atomic<std::uint8_t> middle = 1;  /* index | DIRTY, swapped by both sides */
+        std::uint8_t back  = 0;                /* owned by the producer */
+        std::uint8_t front = 2;                /* owned by the consumer */
+};
 
-        int rc = close(pipe_fds[1]);
-        die(rc < 0, "close");
-}
+/* bounded lock-free multi-producer queue, workers publish into it and the main thread drains it */
+struct ResultQueue
+{
+        struct Cell {
+                std::atomic<std::size_t> sequence;
+                PoolResult result;
+        };
 
-int
-get_named_socket()
+        std::array<Cell, POOL_RESULTS_SIZE> cells;
+        alignas(64) std::atomic<std::size_t> enqueue_pos = 0;
+        alignas(64) std::size_t dequeue_pos = 0;
+};
+
+struct Worker
 {
-        const int sock_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-        die(sock_fd < 0, "socket");
+        std::mutex lock;
+        std::deque<PoolJob> jobs;  /* owner pops from the back, thieves steal from the front */
+        std::thread thread;
+};
 
-        struct sockaddr_un name;
-        memset(&name, 0, sizeof(name));
-        name.sun_family = AF_UNIX;
-        strncpy(name.sun_path, SOCKET_PATH, sizeof(name.sun_path) - 1);
+struct BuiltinJobState
+{
+        FieldPublication publication;
+        bool in_flight            = false;
+        std::uint32_t reruns      = 0;  /* requests that arrived while in flight, toggles must not be merged */
+        std::uint64_t received_us = 0;
+};
 
-        const int rc = bind(sock_fd, (const struct sockaddr*)&name, sizeof(name));
-        die(rc < 0, "bind");
+struct FieldDependency
+{
+        int source;
+        bool (*crossed)(const FieldBuffer* before, const FieldBuffer* after);
+        int derived;
+};
 
-        return sock_fd;
-}
+/* styles a field by the first number in its text, the first matching rule of the field wins */
+struct ThresholdRule
+{
+        enum Op {
+                Greater = 0,  /* Above and Below are taken by X.h */
+                Less
+        };
 
-void DWMSTATUS_NORETURN
-perror_exit(const char* why)
+        int field;
+        int op;
+        double value;
+        std::string_view color;  /* status2d color, #rrggbb */
+};
+
+/* samples of a field drawn after it, quantized between min and max */
+struct Sparkline
 {
-        perror(why);
-        exit(EXIT_FAILURE);
-}
+        int field;
+        double min;
+        double max;
+};
 
-int
-read_cmd_output(const char* cmd, FieldBuffer* field_buffer)
+/* sample rings of the active sparklines, one row per sparkline */
+struct SparklineHistory
 {
-        int rc;
+        std::array<std::array<std::uint8_t, SPARKLINE_SAMPLES>, MAX_SPARKLINES> levels = {};  /* 0..7 */
+        std::array<std::uint8_t, MAX_SPARKLINES> head  = {};  /* next slot of the ring */
+        std::array<std::uint8_t, MAX_SPARKLINES> count = {};
+        /* the ring drawn oldest first, shifted by one glyph per sample instead of redrawn */
+        std::array<std::array<char, SPARKLINE_SAMPLES * 3>, MAX_SPARKLINES> glyphs = {};
+};
 
-        /* create pipe */
-        int pipe_fds[2];
-        rc = pipe(pipe_fds);
-        die(rc < 0, "pipe");
+/* a sliding window over the first number of a field */
+struct AggregateWindow
+{
+        enum Aggregate {
+                Min = 0,
+                Max,
+                Avg,
+                Rate,  /* per second, newest against oldest sample */
+                AggregateSize
+        };
 
-        /* create child */
-        create_child(cmd, pipe_fds);
+        int field;
+        std::uint32_t window_ms;
+};
 
-        auto& [len, buf] = *field_buffer;
+/* sequence numbers of the samples that can still become the minimum (maximum), a ring */
+struct MonotonicDeque
+{
+        std::array<std::uint64_t, WINDOW_SAMPLES> seqs = {};
+        std::size_t front = 0;
+        std::size_t count = 0;
+};
 
-        /* read all characters from the pipe */
-        buf[len = 0] = '\0';
-        const ssize_t b_read = read_all(pipe_fds[0], buf, BUFFER_MAX_SIZE);
-        die(b_read < 0, "read");
+/* samples of one window, sample `seq` lives at seq % WINDOW_SAMPLES */
+struct WindowState
+{
+        std::array<std::uint64_t, WINDOW_SAMPLES> times_ms = {};
+        std::array<double, WINDOW_SAMPLES> values          = {};
+        std::uint64_t first_seq = 0;  /* oldest sample still in the window */
+        std::uint64_t next_seq  = 0;
+        double sum              = 0;
+        MonotonicDeque min;
+        MonotonicDeque max;
+};
 
-        /* null-terminate and delete trailing newline */
-        buf[len = b_read] = '\0';
-        if(len > 0 && buf[len - 1] == '\n')
-                buf[--len] = '\0';
+/* a derived field: an expression over field values compiled to a stack program */
+struct ExprProgram
+{
+        enum Code {
+                Const = 0,
+                Load,       /* first number of a field */
+                Aggregate,  /* of the first window over a field */
+                Add,
+                Sub,
+                Mul,
+                Div,
+                Neg,
+                Pos         /* leaves the field empty unless the value is above zero */
+        };
 
-        /* cleanup */
-        rc = close(pipe_fds[0]);
-        if(rc < 0)
+        struct Op {
+                std::uint8_t code      = Const;
+                std::uint8_t field     = 0;  /* Load, Aggregate */
+                std::uint8_t aggregate = 0;  /* Aggregate */
+                double constant        = 0;  /* Const */
+        };
+
+        std::array<Op, EXPR_MAX_OPS> ops = {};
+        std::size_t op_count        = 0;
+        std::uint32_t field_inputs  = 0;  /* re-evaluated when one of these changes */
+        std::uint32_t window_inputs = 0;  /* re-evaluated on every sample of these */
+        int precision               = 0;  /* decimals printed */
+        const char* error           = nullptr;
+};
+
+/* recursive descent over + - * /, unary minus, parentheses, numbers, field names and min|max|avg|rate(field) */
+struct ExprCompiler
+{
+        std::string_view source;
+        std::size_t pos   = 0;
+        std::size_t depth = 0;  /* stack depth after the ops emitted so far */
+        ExprProgram program;
+
+        constexpr void fail(const char* why)
         {
-                wait(nullptr);
-                return rc;
+                if(program.error == nullptr)
+                        program.error = why;
         }
 
-        rc = wait(nullptr);
-        if(rc < 0)
-                return rc;
+        constexpr bool accept(const char c)
+        {
+                while(pos < source.size() && (source[pos] == ' ' || source[pos] == '\t'))
+                        ++pos;
 
-        return 0;
-}
+                if(pos < source.size() && source[pos] == c)
+                {
+                        ++pos;
+                        return true;
+                }
 
-void
-run_update(const FieldUpdate* field_update)
+                return false;
+        }
+
+        constexpr void emit(const ExprProgram::Op op)
+        {
+                if(program.op_count == program.ops.size())
+                        return fail("expression: longer than EXPR_MAX_OPS");
+
+                const bool operand = op.code == ExprProgram::Const || op.code == ExprProgram::Load || op.code == ExprProgram::Aggregate;
+                const bool unary = op.code == ExprProgram::Neg || op.code == ExprProgram::Pos;
+                depth = operand ? depth + 1 : unary ? depth : depth - 1;
+                if(depth > EXPR_STACK_SIZE)
+                        return fail("expression: nested deeper than EXPR_STACK_SIZE");
+
+                program.ops[program.op_count++] = op;
+        }
+
+        constexpr std::string_view identifier()
+        {
+                accept(' ');
+                const std::size_t start = pos;
+                while(pos < source.size() && ((source[pos] >= 'a' && source[pos] <= 'z') || (source[pos] >= '0' && source[pos] <= '9') || source[pos] == '_'))
+                        ++pos;
+
+                return source.substr(start, pos - start);
+        }
+
+        constexpr int field(const std::string_view name)
+        {
+                for(std::size_t f = 0; f < field_names.size(); ++f)
+                {
+                        if(field_names[f] == name)
+                                return int(f);
+                }
+
+                fail("expression: unknown field");
+                return 0;
+        }
+
+        constexpr void number()
+        {
+                double value = 0;
+                double scale = 0;
+                for(; pos < source.size() && ((source[pos] >= '0' && source[pos] <= '9') || (source[pos] == '.' && scale == 0)); ++pos)
+                {
+                        if(source[pos] == '.')
+                                scale = 1;
+                        else if(scale == 0)
+                                value = value * 10 + (source[pos] - '0');
+                        else
+                                value += (source[pos] - '0') * (scale /= 10);
+                }
+
+                emit({ ExprProgram::Const, 0, 0, value });
+        }
+
+        constexpr void factor()
+        {
+                if(accept('-'))
+                {
+                        factor();
+                        return emit({ ExprProgram::Neg });
+                }
+
+                if(accept('('))
+                {
+                        sum();
+                        if(!accept(')'))
+                                fail("expression: missing )");
+                        return;
+                }
+
+                if(pos < source.size() && ((source[pos] >= '0' && source[pos] <= '9') || source[pos] == '.'))
+                        return number();
+
+                const std::string_view name = identifier();
+                if(name.empty())
+                        return fail("expression: expected a number, field or window");
+
+                if(!accept('('))
+                {
+                        const int f = field(name);
+                        program.field_inputs |= 1u << f;
+                        return emit({ ExprProgram::Load, std::uint8_t(f) });
+                }
+
+                /* pos(expression) passes positive values only, e.g. a time left that a sign flip makes meaningless */
+                if(name == "pos")
+                {
+                        sum();
+                        if(!accept(')'))
+                                return fail("expression: missing )");
+
+                        return emit({ ExprProgram::Pos });
+                }
+
+                /* min|max|avg|rate(field) reads the first window over the field */
+                int aggregate = -1;
+                if(name == "min")
+                        aggregate = AggregateWindow::Min;
+                else if(name == "max")
+                        aggregate = AggregateWindow::Max;
+                else if(name == "avg")
+                        aggregate = AggregateWindow::Avg;
+                else if(name == "rate")
+                        aggregate = AggregateWindow::Rate;
+                else
+                        return fail("expression: unknown function");
+
+                const int f = field(identifier());
+                if(!accept(')'))
+                        return fail("expression: missing )");
+
+                program.window_inputs |= 1u << f;
+                emit({ ExprProgram::Aggregate, std::uint8_t(f), std::uint8_t(aggregate) });
+        }
+
+        constexpr void product()
+        {
+                factor();
+                for(;;)
+                {
+                        if(accept('*'))
+                        {
+                                factor();
+                                emit({ ExprProgram::Mul });
+                        }
+                        else if(accept('/'))
+                        {
+                                factor();
+                                emit({ ExprProgram::Div });
+                        }
+                        else
+                        {
+                                return;
+                        }
+                }
+        }
+
+        constexpr void sum()
+        {
+                product();
+                for(;;)
+                {
+                        if(accept('+'))
+                        {
+                                product();
+                                emit({ ExprProgram::Add });
+                        }
+                        else if(accept('-'))
+                        {
+                                product();
+                                emit({ ExprProgram::Sub });
+                        }
+                        else
+                        {
+                                return;
+                        }
+                }
+        }
+};
+
+/* the status2d escape of a rule, built when the rules are installed */
+struct StyleEscape
+{
+        std::uint8_t length = 0;
+        char data[STYLE_ESCAPE_SIZE] = {};
+};
+
+/* jiffies from /proc/stat, row 0 is the "cpu" total and row n + 1 is cpun; arrays so the delta loop vectorizes */
+struct CpuTimes
+{
+        std::array<std::uint64_t, MAX_CPUS + 1> busy = {};
+        std::array<std::uint64_t, MAX_CPUS + 1> idle = {};
+};
+
+/* links the net field shows, published by the main thread from rtnetlink events */
+struct NetLinks
+{
+        std::array<std::array<char, IFNAMSIZ>, MAX_NET_LINKS> names = {};
+        std::size_t count = 0;
+};
+
+/* byte counters of the shown links, parallel to NetLinks::names */
+struct NetCounters
+{
+        std::array<std::uint64_t, MAX_NET_LINKS> rx = {};
+        std::array<std::uint64_t, MAX_NET_LINKS> tx = {};
+        std::uint32_t valid = 0;  /* bit per link with a previous sample */
+};
+
+/* block devices read_dio() follows, resolved once at startup */
+struct BlockDevices
+{
+        std::array<unsigned, MAX_BLOCK_DEVICES> major = {};
+        std::array<unsigned, MAX_BLOCK_DEVICES> minor = {};
+        std::array<std::array<char, 32>, MAX_BLOCK_DEVICES> names = {};
+        std::size_t count = 0;
+};
+
+/* sectors read and written, parallel to BlockDevices */
+struct DiskCounters
+{
+        std::array<std::uint64_t, MAX_BLOCK_DEVICES> read    = {};
+        std::array<std::uint64_t, MAX_BLOCK_DEVICES> written = {};
+        std::uint32_t valid = 0;  /* bit per device seen in the last read */
+};
+
+/* previous cpu time per pid, open addressing on the pid */
+struct ProcSamples
+{
+        std::array<std::int32_t, TOP_TABLE_SIZE> pid = {};  /* 0: free slot */
+        std::array<std::uint64_t, TOP_TABLE_SIZE> ticks = {};
+        std::array<std::uint64_t, TOP_TABLE_SIZE> sampled_ms = {};
+        std::array<std::uint32_t, TOP_TABLE_SIZE> cycle = {};  /* last scan cycle the pid was seen in */
+        std::size_t count = 0;
+};
+
+/* a link as last reported by rtnetlink */
+struct LinkInfo
+{
+        int index;
+        std::array<char, IFNAMSIZ> name;
+        unsigned flags;
+};
+
+struct Stats
+{
+        std::uint64_t start_ms          = 0;
+        std::uint64_t wakeups           = 0;
+        std::uint64_t budget_exhausted  = 0;  /* loop iterations that deferred background work */
+        std::uint64_t interactive_count = 0;
+        std::uint64_t file_reads        = 0;
+        std::uint64_t read_syscalls     = 0;  /* io_uring_enter or pread calls spent on file_reads */
+        std::array<std::uint32_t, LATENCY_SAMPLES> interactive_latency_us = {};  /* ring */
+};
+
+struct PeriodicState
+{
+        std::uint64_t deadline_ms     = 0;
+        std::uint32_t interval_ms     = 0;
+        std::uint32_t unchanged_count = 0;
+};
+
+struct FieldLayout
+{
+        int field                = -1;  /* must match the position in StatusLayout::fields */
+        std::string_view prefix;
+        std::string_view suffix;
+        std::uint32_t max_width  = 0;   /* characters, 0 for no cap */
+        bool visible             = true;
+        std::uint8_t priority    = 0;   /* over the width budget the lowest priority is cut first */
+};
+
+struct StatusLayout
+{
+        std::string_view open;
+        std::string_view separator;  /* between visible fields */
+        std::string_view close;
+        std::array<FieldLayout, R_SIZE> fields;
+        std::array<std::int8_t, R_SIZE> order = {};  /* drawing order, fields in enum order when order_count is 0 */
+        std::size_t order_count = 0;
+};
+
+#ifndef NO_XFT
+/* advance widths of the bar font, measured once per glyph */
+struct GlyphCache
+{
+        struct Entry {
+                std::uint32_t codepoint = 0;  /* 0 marks a free slot */
+                std::uint16_t width     = 0;
+        };
+
+        std::array<std::uint16_t, 128> ascii     = {};
+        std::array<Entry, GLYPH_CACHE_SIZE> other = {};  /* open addressing */
+};
+#endif
+
+struct Page
+{
+        std::string_view name;
+        std::uint32_t fields;  /* bit per field shown on the page */
+};
+
+/* a layout flattened into literal runs and field slots, drawn with memcpy only */
+struct RenderPlan
+{
+        struct Segment {
+                std::uint16_t literal_offset;
+                std::uint16_t literal_length;  /* copied before the field */
+                std::int16_t field;            /* -1 on the closing segment */
+                std::uint16_t max_width;
+        };
+
+        std::array<char, RENDER_LITERALS_SIZE> literals = {};
+        std::array<Segment, R_SIZE + 1> segments        = {};
+        std::size_t segment_count                       = 0;
+        const char* error                               = nullptr;
+};
+
+/* one field as written in the config file */
+struct FieldSpec
+{
+        enum Kind {
+                Default = 0,  /* the compiled-in updater */
+                Shell,
+                File,
+                Expr,
+                Off
+        };
+
+        int kind                      = Default;
+        bool periodic                 = false;  /* intervals given */
+        std::uint32_t min_interval_ms = 0;
+        std::uint32_t max_interval_ms = 0;
+        std::string arg;                        /* command or path */
+        ExprProgram program;                    /* Expr, compiled while parsing */
+};
+
+struct HotkeySpec
+{
+        std::uint32_t id;
+        int field;                       /* resolved against the config's own updaters, -1 for the meta targets */
+        const FieldUpdate* field_update;  /* meta targets */
+        int priority;
+};
+
+struct ThresholdSpec
+{
+        int field;
+        int op;
+        double value;
+        std::string color;
+};
+
+struct SparklineSpec
+{
+        int field;
+        double min;
+        double max;
+};
+
+struct WindowSpec
+{
+        int field;
+        std::uint32_t window_ms;
+};
+
+struct PageSpec
+{
+        std::string name;
+        std::uint32_t fields;
+};
+
+struct ConfigSpec
+{
+        std::array<FieldSpec, R_SIZE> fields;
+        std::vector<HotkeySpec> hotkeys;
+        std::string status_fmt;  /* empty for the compiled-in layout */
+        std::vector<PageSpec> pages;  /* empty for the compiled-in pages */
+        std::vector<ThresholdSpec> thresholds;  /* empty for the compiled-in rules */
+        std::vector<SparklineSpec> sparklines;  /* empty for the compiled-in sparklines */
+        std::vector<WindowSpec> windows;  /* empty for the compiled-in windows */
+        std::uint32_t page_interval_ms = PAGE_ROTATE_MS;
+        std::uint32_t width_budget_px  = STATUS_WIDTH_PX;
+};
+
+/* a config file compiled into the same flat tables the compile-time config uses */
+struct Config
+{
+        std::deque<std::string> strings;  /* commands and paths, addresses stay stable */
+        std::deque<ExprProgram> programs;  /* derived fields, addresses stay stable */
+        std::vector<FieldUpdate> updates;  /* reserved up front, never reallocated */
+        std::array<const FieldUpdate*, R_SIZE> updaters;
+        std::vector<PeriodicUpdate> periodic;
+        std::vector<RealTimeUpdate> real_time;
+        std::string status_fmt;
+        StatusLayout layout;  /* views into status_fmt */
+        std::vector<Page> pages;
+        std::vector<ThresholdRule> thresholds;  /* colors view into strings */
+        std::vector<Sparkline> sparklines;
+        std::vector<AggregateWindow> windows;
+        std::uint32_t page_interval_ms;
+        std::uint32_t width_budget_px;
+};
+
+constexpr RenderPlan
+make_render_plan(const StatusLayout& layout, const std::uint32_t shown = ALL_FIELDS)
+{
+        RenderPlan plan;
+        std::size_t used = 0;
+
+        /* everything between two slots is merged into one literal run */
+        auto append = [&](std::string_view s)
+        {
+                for(const char c : s)
+                {
+                        if(used == plan.literals.size())
+                        {
+                                plan.error = "literals overflow RENDER_LITERALS_SIZE";
+                                return;
+                        }
+
+                        plan.literals[used++] = c;
+                }
+        };
+
+        std::size_t run_start = 0;
+        append(layout.open);
+
+        bool first = true;
+        for(std::size_t k = 0; k < (layout.order_count > 0 ? layout.order_count : layout.fields.size()); ++k)
+        {
+                const std::size_t i = layout.order_count > 0 ? std::size_t(layout.order[k]) : k;
+                const FieldLayout& f = layout.fields[i];
+                if(f.field != int(i))
+                {
+                        plan.error = "layout fields are not in field enum order";
+                        return plan;
+                }
+
+                if(!f.visible || !(shown & (1u << i)))
+                        continue;
+
+                if(!first)
+                        append(layout.separator);
+                append(f.prefix);
+
+                plan.segments[plan.segment_count++] = {
+                        std::uint16_t(run_start),
+                        std::uint16_t(used - run_start),
+                        std::int16_t(i),
+                        std::uint16_t(std::min<std::uint32_t>(f.max_width, BUFFER_MAX_SIZE))
+                };
+
+                run_start = used;
+                append(f.suffix);
+                first = false;
+        }
+
+        append(layout.close);
+        plan.segments[plan.segment_count++] = { std::uint16_t(run_start), std::uint16_t(used - run_start), -1, 0 };
+
+        return plan;
+}
+
+/* "[{time} |{load} ...]" or "[{} |{} ...]" style formats: text before the first slot opens,
+   text after a slot is its field's suffix, fields without a slot are hidden */
+constexpr StatusLayout
+layout_from_format(const std::string_view format)
+{
+        StatusLayout layout = {};
+        for(int f = 0; f < R_SIZE; ++f)
+        {
+                layout.fields[f].field = f;
+                layout.fields[f].visible = false;
+        }
+
+        std::size_t start = 0;
+        int field = -1;
+        int next_positional = 0;
+
+        for(std::size_t i = 0; i < format.size() && layout.order_count < R_SIZE; ++i)
+        {
+                if(format[i] != '{')
+                        continue;
+
+                const std::size_t end = format.find('}', i + 1);
+                if(end == std::string_view::npos)
+                        break;
+
+                const std::string_view name = format.substr(i + 1, end - i - 1);
+                const auto named = std::find(field_names.begin(), field_names.end(), name);
+                const int slot = name.empty() ? next_positional++ : int(named - field_names.begin());
+                if(slot >= R_SIZE)
+                        break;
+
+                const std::string_view text = format.substr(start, i - start);
+                if(field < 0)
+                        layout.open = text;
+                else
+                        layout.fields[field].suffix = text;
+
+                field = slot;
+                layout.fields[field].visible = true;
+                layout.order[layout.order_count++] = std::int8_t(field);
+                start = end + 1;
+                i = end;
+        }
+
+        if(field >= 0)
+                layout.fields[field].suffix = format.substr(start);
+        else
+                layout.open = format;
+
+        return layout;
+}
+
+constexpr ExprProgram
+compile_expression(const std::string_view source, const int precision)
+{
+        ExprCompiler compiler;
+        compiler.source = source;
+        compiler.program.precision = precision;
+        compiler.sum();
+
+        if(compiler.accept(')') || compiler.pos < compiler.source.size())
+                compiler.fail("expression: unexpected text");
+
+        return compiler.program;
+}
+
+constexpr bool
+valid_color(const std::string_view color)
+{
+        if(color.size() != 7 || color[0] != '#')
+                return false;
+
+        for(const char c : color.substr(1))
+        {
+                if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+                        return false;
+        }
+
+        return true;
+}
+
+/* template function declarations */
+template<std::size_t N>
+static void refresh_now(const std::array<int, N>& fields);
+template<int... fields>
+static void refresh_fields();
+
+/* function declarations */
+static void die(const bool cond, const char* why);
+static ssize_t read_all(const int fd, void* buffer, const size_t nbytes);
+static pid_t create_child(const char* cmd, const int pipe_fds[2], const bool own_group);
+static int get_named_socket();
+static void perror_exit(const char* why) DWMSTATUS_NORETURN;
+static int read_cmd_output(const char* cmd, FieldBuffer* field_buffer);
+static void run_update(const FieldUpdate* field_update);
+static bool refresh_field(const FieldUpdate* field_update);
+static const FieldUpdate* active_updater(const FieldUpdate* field_update);
+static bool field_refreshed(const FieldUpdate* field_update, const FieldBuffer* old);
+static void field_changed(const int field);
+static bool first_number(const FieldBuffer& field_buffer, double* value);
+static void restyle_field(const int field);
+static std::vector<StyleEscape> make_style_escapes(std::span<const ThresholdRule> rules);
+static void record_sample(const int field);
+static void push_sparkline(const int row, const double value);
+static void window_push(WindowState* w, const std::uint64_t now_ms, const double value);
+static void window_drop_oldest(WindowState* w);
+static void window_expire(WindowState* w, const std::uint64_t now_ms, const std::uint32_t window_ms);
+static bool window_aggregate(const std::size_t index, const int aggregate, double* value);
+static void reset_samples();
+static bool evaluate(const ExprProgram& program, double* result);
+static void run_expr(const FieldUpdate* field_update);
+static bool refresh_dependents(const int field, const bool text_changed);
+static std::uint32_t dependency_mask(const std::array<const FieldUpdate*, R_SIZE>& updaters);
+static void record_interactive_latency(const std::uint64_t received_us);
+static void init_uring();
+#ifndef NO_IO_URING
+static void read_files_uring(FileRead* reads, const std::size_t count);
+#endif
+static void read_files(FileRead* reads, const std::size_t count);
+static void refresh_files(const FieldUpdate* const* updates, const std::size_t count, bool* changed);
+static void parse_load(FieldBuffer* field_buffer);
+static IoAwaiter wait_readable(const int fd, const std::uint64_t deadline_ms);
+static IoAwaiter wait_writable(const int fd, const std::uint64_t deadline_ms);
+static IoAwaiter sleep_until(const std::uint64_t deadline_ms);
+static Task<int> run_command(const char* cmd, FieldBuffer* field_buffer, const std::uint64_t deadline_ms);
+static Task<bool> http_get(const char* host, const char* path, FieldBuffer* field_buffer, const std::uint64_t deadline_ms);
+static void reactor_watch(IoAwaiter* awaiter, std::coroutine_handle<> handle);
+static int reactor_timeout(const int timeout);
+static void reactor_dispatch();
+static void start_coroutine(const FieldUpdate* field_update, const std::uint64_t received_us);
+static void finish_coroutine(const std::size_t idx);
+static Task<> fetch_weather(FieldBuffer* field_buffer);
+static Task<> fetch_temp(FieldBuffer* field_buffer);
+static void load_plugins();
+static void unload_plugins();
+static bool plugin_owns(const FieldUpdate* field_update);
+static bool run_plugin(Plugin* plugin);
+static int run_due_plugins();
+static void handle_plugin_events();
+static void init_pool();
+static void stop_pool();
+static void worker_main(const std::size_t self);
+static bool pool_take(const std::size_t self, PoolJob* job);
+static void pool_submit(const FieldUpdate* field_update, const std::uint64_t received_us);
+static FieldBuffer* publication_back(FieldPublication* publication);
+static void publication_publish(FieldPublication* publication);
+static const FieldBuffer* publication_consume(FieldPublication* publication);
+static void publish_result(const PoolResult& result);
+static bool pop_result(PoolResult* result);
+static void drain_pool_results();
+static std::uint64_t monotonic_ms();
+static std::uint64_t monotonic_us();
+static std::uint64_t clock_ms(const clockid_t clock);
+static std::uint64_t align_to_tick(const std::uint64_t now, const std::uint64_t interval_ms);
+static std::uint32_t interval_multiplier(const PeriodicUpdate& u);
+static bool read_on_battery();
+static void update_power_state(const std::uint64_t now);
+static void init_power();
+static void init_scheduler();
+static void reschedule(const std::size_t idx, const bool changed, const std::uint64_t now);
+static void reschedule_field(const FieldUpdate* field_update, const bool changed, const std::uint64_t now);
+static std::string_view next_token(std::string_view* line);
+static bool parse_u32(const std::string_view token, std::uint32_t* value);
+static bool parse_double(const std::string_view token, double* value);
+static const char* parse_config_line(std::string_view line, ConfigSpec* spec);
+static bool parse_config(const char* path, ConfigSpec* spec);
+static std::unique_ptr<Config> build_config(const ConfigSpec& spec);
+static bool read_config(std::unique_ptr<Config>* next);
+static bool same_update(const FieldUpdate* a, const FieldUpdate* b);
+static void install_config(std::unique_ptr<Config> next);
+static void apply_config(std::unique_ptr<Config> next);
+static void init_config();
+static void handle_config_events();
+static void print_stats();
+static void arm_clock_timer();
+static void init_clock_watch();
+static void handle_clock_timer();
+static void handle_tz_events();
+static void init_netlink();
+static void handle_netlink_events();
+static bool publish_net_links();
+static void init_psi();
+static void init_block_devices();
+static dev_t mount_source_device(const char* path);
+static void add_block_device(const dev_t dev);
+static void handle_psi_events();
+static void recheck_psi();
+static bool all_psi_triggers();
+static bool detect_resume();
+static int run_due_updates(const std::uint64_t budget_end_ms);
+static bool queue_push(RequestQueue* queue, const PendingRequest& req);
+static bool queue_pop(RequestQueue* queue, PendingRequest* req);
+static void service_interactive();
+static bool run_background(const std::uint64_t budget_end_ms);
+static int run_scheduler();
+static bool crossed_midnight(const FieldBuffer* before, const FieldBuffer* after);
+static void toggle_lang(FieldBuffer* field_buffer);
+static void toggle_cpu_gov(FieldBuffer* field_buffer);
+static void toggle_mic(FieldBuffer* field_buffer);
+static void read_cpu(FieldBuffer* field_buffer);
+static void read_net(FieldBuffer* field_buffer);
+static void read_psi(FieldBuffer* field_buffer);
+static void read_disk(FieldBuffer* field_buffer);
+static void read_dio(FieldBuffer* field_buffer);
+static void read_top(FieldBuffer* field_buffer);
+static std::size_t proc_sample_slot(const ProcSamples& samples, const std::int32_t pid);
+static void prune_proc_samples(const ProcSamples& from, ProcSamples* to, const std::uint32_t cycle);
+static bool parse_pid_stat(const char* text, const char* end, std::string_view* comm, std::uint64_t* ticks);
+static std::size_t format_bytes(char* out, const std::uint64_t bytes);
+static std::uint64_t scan_u64(const char** p, const char* end);
+static std::size_t parse_proc_stat(const char* p, const char* end, CpuTimes* times);
+static void cpu_busy_percent(const CpuTimes& prev, const CpuTimes& cur, const std::size_t rows, std::uint8_t* busy_pct);
+static void refresh_polled();
+static void next_page();
+static bool field_visible(const FieldUpdate* field_update);
+static void update_visibility(const bool force);
+static void terminator();
+static void init_signals();
+static void init_x();
+static void handle_x_events();
+static bool query_screen_blanked();
+static bool update_blank_state();
+static void catch_up_after_blank();
+static void init_statusbar();
+#ifndef NO_XFT
+static void init_font();
+static std::uint32_t glyph_width(const std::uint32_t codepoint);
+static std::uint32_t decode_utf8(const char* data, const std::size_t length, std::size_t* pos);
+static std::uint32_t text_width(const char* data, const std::size_t length);
+static std::size_t fit_length(const char* data, const std::size_t length, const std::uint32_t max_px);
+static void fit_to_budget(std::array<std::uint32_t, R_SIZE>* lengths, std::uint32_t* sparklines_shown);
+#endif
+static std::size_t capped_length(const FieldBuffer& field_buffer, const std::uint32_t max_width);
+static void update_screen();
+static void handle_received(const std::uint32_t id, const std::uint64_t received_us);
+static void drain_socket();
+static void cleanup_and_exit(const int sig) DWMSTATUS_NORETURN;
+static void run();
+
+/* global variables */
+static std::array<FieldBuffer, R_SIZE> field_buffers = {};
+static bool running = true;
+static Stats stats = {};
+static RequestQueue interactive_queue = {};
+static RequestQueue background_queue = {};
+static std::array<Worker, POOL_WORKERS> workers;
+static std::counting_semaphore<> pool_pending(0);
+static std::atomic<bool> pool_stopping = false;
+
+/* links known to the main thread, and the subset handed to read_net() on the pool */
+static std::vector<LinkInfo> links;
+static std::mutex net_links_lock;
+static NetLinks net_links;
+static std::atomic<std::uint32_t> net_links_generation = 0;  /* bumped when net_links changes */
+static bool net_links_stale = false;  /* the set changed while net was hidden */
+
+/* written by init_block_devices() before the pool starts, read-only afterwards */
+static BlockDevices block_devices;
+
+/* psi is read when a trigger fires and while the averages settle, polled only while a file has no live trigger */
+static bool psi_triggers = false;
+static std::uint64_t psi_deadline_ms = UINT64_MAX;
+static std::uint64_t psi_settle_until_ms = 0;
+static std::size_t pool_next = 0;
+static ResultQueue pool_results;
+#ifndef NO_IO_URING
+static Uring uring;
+#endif
+static int ac_online_fd = -1;
+static bool on_battery = false;
+static bool screen_blanked = false;
+static std::array<struct pollfd, P_SIZE + MAX_CORO_WAITERS + MAX_PLUGINS> pollfds = {};
+static std::array<Plugin, MAX_PLUGINS> plugins = {};
+static std::size_t plugin_count = 0;
+static std::array<bool, R_SIZE> plugin_fields = {};  /* fields taken over by a plugin */
+static std::array<CoroWaiter, MAX_CORO_WAITERS> coro_waiters = {};
+static std::uint64_t suspended_ms = 0;  /* CLOCK_BOOTTIME - CLOCK_MONOTONIC at the last check */
+static bool clock_changed = false;
+static char config_path[PATH_MAX] = {};
+#ifndef NO_X11
+static Display* dpy = nullptr;
+static int screen;
+static Window root;
+static int xss_event_base = -1;
+static bool saver_active = false;
+static bool have_dpms = false;
+static bool dpms_off = false;
+static std::uint64_t dpms_checked_ms = 0;  /* 0: query on the next check */
+#endif
+#ifndef NO_XFT
+static XftFont* bar_font = nullptr;
+static GlyphCache glyph_cache;
+static std::array<std::uint32_t, R_SIZE> field_widths = {};  /* pixels, stale for fields in dirty_widths */
+static std::uint32_t literal_width_px = 0;
+static bool literal_width_dirty = true;
+#endif
+static std::uint32_t dirty_widths = ALL_FIELDS;  /* fields changed since they were last measured */
+
+/* field configs */
+#ifdef GENERATED_CONFIG
+#include "dwmstatus-config.h"  /* written by dwmstatus-gen, replaces the tables below */
+#else
+static constexpr StatusLayout STATUS_LAYOUT = {
+        "[",    /* open */
+        " |",   /* separator */
+        "]",    /* close */
+        {{
+                /* field        prefix  suffix  max width   visible priority */
+                { R_TIME,       "",     "",     0,          true,   3 },
+                { R_LOAD,       "",     "",     0,          true,   1 },
+                { R_CPU,        "",     "",     0,          true,   1 },
+                { R_NET,        "",     "",     0,          true,   1 },
+                { R_PSI,        "",     "",     0,          true,   1 },
+                { R_DISK,       "",     "",     0,          true,   1 },
+                { R_DIO,        "",     "",     0,          true,   0 },
+                { R_TOP,        "",     "",     0,          true,   1 },
+                { R_TEMP,       "",     "",     0,          true,   1 },
+                { R_VOL,        "",     "",     0,          true,   2 },
+                { R_MIC,        "",     "",     0,          true,   2 },
+                { R_MEM,        "",     "",     0,          true,   1 },
+                { R_GOV,        "",     "",     0,          true,   0 },
+                { R_LANG,       "",     "",     0,          true,   2 },
+                { R_WTH,        "",     "",     0,          true,   0 },
+                { R_DATE,       "",     "",     0,          true,   2 },
+                { R_BAT,        "",     "",     0,          true,   3 },
+                { R_EXPR1,      "",     "",     0,          true,   0 },
+                { R_EXPR2,      "",     "",     0,          true,   0 }
+        }}
+};
+
+static constexpr std::array shell_updates = std::to_array<FieldUpdate>({
+        {       /* time */
+                R"(date +%H:%M:%S)",        /* shell command */
+                &field_buffers[R_TIME]      /* reference to root buffer */
+        },
+        {       /* volume */
+                R"(amixer sget Master | tail -n1 | get-from-to '[' ']' '--amixer')",
+                &field_buffers[R_VOL]
+        },
+        {       /* memory usage */
+                R"(xss-get-mem)",
+                &field_buffers[R_MEM]
+        },
+        {       /* date */
+                R"(date "+%d.%m.%Y")",
+                &field_buffers[R_DATE]
+        }
+});
+
+static constexpr std::array builtin_updates = std::to_array<FieldUpdate>({
+       /* pointer to function   reference to root buffer */
+        { &toggle_lang,         &field_buffers[R_LANG] },
+        { &toggle_cpu_gov,      &field_buffers[R_GOV]  },
+        { &toggle_mic,          &field_buffers[R_MIC]  },
+        { &read_cpu,            &field_buffers[R_CPU]  },
+        { &read_net,            &field_buffers[R_NET]  },
+        { &read_psi,            &field_buffers[R_PSI]  },
+        { &read_disk,           &field_buffers[R_DISK] },
+        { &read_dio,            &field_buffers[R_DIO]  },
+        { &read_top,            &field_buffers[R_TOP]  }
+});
+
+static constexpr std::array file_updates = std::to_array<FieldUpdate>({
+       /* procfs/sysfs path     post-processing     reference to root buffer */
+        { LOADAVG_PATH,         &parse_load,        &field_buffers[R_LOAD] },
+        { BATTERY_PATH,         nullptr,            &field_buffers[R_BAT]  }
+});
+
+static constexpr std::array coroutine_updates = std::to_array<FieldUpdate>({
+       /* coroutine             reference to root buffer */
+        { &fetch_weather,       &field_buffers[R_WTH]  },
+        { &fetch_temp,          &field_buffers[R_TEMP] }
+});
+
+static constexpr std::array meta_updates = std::to_array<FieldUpdate>({
+     /* pointer to function */
+        &refresh_polled,
+        &terminator,
+        &print_stats,
+        &next_page
+});
+
+static constexpr auto real_time_updates = std::to_array<RealTimeUpdate>({
+        { &meta_updates[1],     RealTimeUpdate::Interactive },  /* 0 */
+        { &shell_updates[1],    RealTimeUpdate::Interactive },  /* 1 */
+        { &coroutine_updates[0], RealTimeUpdate::Background },  /* 2 */
+        { &builtin_updates[0],  RealTimeUpdate::Interactive },  /* 3 */
+        { &builtin_updates[1],  RealTimeUpdate::Interactive },  /* 4 */
+        { &builtin_updates[2],  RealTimeUpdate::Interactive },  /* 5 */
+        { &meta_updates[0],     RealTimeUpdate::Background  },  /* 6 */
+        { &meta_updates[2],     RealTimeUpdate::Background  },  /* 7 */
+        { &meta_updates[3],     RealTimeUpdate::Interactive }   /* 8 */
+});
+
+static constexpr auto periodic_updates = std::to_array<PeriodicUpdate>({
+        /* field update         min interval (ms)   max interval (ms)   essential */
+        { &shell_updates[0],    1000,               1000,               false },  /* time */
+        { &file_updates[0],     2000,               30000,              false },  /* sys load */
+        { &builtin_updates[3],  2000,               30000,              false },  /* cpu usage */
+        { &builtin_updates[4],  2000,               30000,              false },  /* network rates */
+        { &builtin_updates[6],  60000,              600000,             false },  /* free disk space */
+        { &builtin_updates[7],  2000,               30000,              false },  /* disk throughput */
+        { &builtin_updates[8],  2000,               2000,               false },  /* top process, a pass over /proc may span refreshes so no backoff */
+        { &coroutine_updates[1], 2000,              30000,              false },  /* cpu temp */
+        { &shell_updates[2],    2000,               30000,              false },  /* memory usage */
+        { &coroutine_updates[0], 600000,            3600000,            false },  /* weather */
+        { &file_updates[1],     30000,              300000,             true  }   /* battery */
+});
+
+/* fields computed from other fields, evaluated again only when an input changes */
+static constexpr auto derived_programs = std::to_array<ExprProgram>({
+        /* expression                                   decimals */
+        compile_expression("pos(bat / -rate(bat) / 3600)", 1)  /* hours of battery left, empty while charging */
+});
+
+static constexpr std::array derived_updates = std::to_array<FieldUpdate>({
+       /* program               reference to root buffer */
+        { &derived_programs[0], &field_buffers[R_EXPR1] }
+});
+#endif
+
+/* derived fields, refreshed only when their source crosses a boundary */
+static constexpr auto field_dependencies = std::to_array<FieldDependency>({
+        /* source       boundary                derived */
+        { R_TIME,       &crossed_midnight,      R_DATE }  /* date follows time */
+});
+
+/* status2d colors, applied when the first number in a field crosses a threshold */
+static constexpr auto threshold_rules = std::to_array<ThresholdRule>({
+        /* field        op                      value   color */
+        { R_TEMP,       ThresholdRule::Greater, 80,     "#ff5555" },
+        { R_TEMP,       ThresholdRule::Greater, 65,     "#ffb86c" },
+        { R_BAT,        ThresholdRule::Less,    15,     "#ff5555" },
+        { R_BAT,        ThresholdRule::Less,    30,     "#ffb86c" },
+        { R_LOAD,       ThresholdRule::Greater, 4,      "#ffb86c" }
+});
+
+/* sample histories drawn after their field, at most MAX_SPARKLINES */
+static constexpr auto sparklines = std::to_array<Sparkline>({
+        /* field        min     max */
+        { R_LOAD,       0,      4 },
+        { R_CPU,        0,      100 }
+});
+
+/* sliding windows derived fields can read min, max, average and rate from, at most MAX_WINDOWS */
+static constexpr auto aggregate_windows = std::to_array<AggregateWindow>({
+        /* field        window (ms) */
+        { R_LOAD,       300000 },  /* load over 5 minutes */
+        { R_TEMP,       60000  },  /* peak temperature over a minute */
+        { R_BAT,        600000 }   /* battery drain rate */
+});
+
+/* fields refreshed at once after resume from suspend and after a clock or timezone change */
+static constexpr auto resume_fields = std::to_array<int>({
+        R_TIME,
+        R_DATE,
+        R_BAT
+});
+
+static constexpr auto clock_change_fields = std::to_array<int>({
+        R_TIME,
+        R_DATE
+});
+
+/* field groups cycled by the page hotkey and every PAGE_ROTATE_MS, all fields when empty */
+static constexpr auto pages = std::to_array<Page>({
+        /* name         fields */
+        { "all",        ALL_FIELDS }
+});
+
+/* the compiled-in updater of every field */
+static constexpr auto default_updaters = [] {
+        std::array<const FieldUpdate*, R_SIZE> updaters = {};
+        auto add = [&](const auto& updates)
+        {
+                for(const FieldUpdate& u : updates)
+                        updaters[u.target() - field_buffers.data()] = &u;
+        };
+
+        add(shell_updates);
+        add(builtin_updates);
+        add(file_updates);
+        add(coroutine_updates);
+        add(derived_updates);
+
+        return updaters;
+}();
+
+/* checked for hand-written and generated tables alike */
+static constexpr RenderPlan default_render_plan = make_render_plan(STATUS_LAYOUT);
+static_assert(default_render_plan.error == nullptr,
+              "STATUS_LAYOUT needs one entry per field in enum order and must fit RENDER_LITERALS_SIZE");
+static_assert(meta_updates.size() == 4, "config files name meta updates by index: refresh, quit, stats, page");
+static_assert(R_SIZE <= 32, "visibility masks hold one bit per field");
+static_assert([] {
+        std::array<int, R_SIZE> owners = {};
+        auto count = [&](const auto& updates)
+        {
+                for(const FieldUpdate& u : updates)
+                        ++owners[u.target() - field_buffers.data()];
+        };
+
+        count(shell_updates);
+        count(builtin_updates);
+        count(file_updates);
+        count(coroutine_updates);
+        count(derived_updates);
+
+        return std::ranges::all_of(owners, [](const int n) { return n <= 1; });
+}(), "a field can have only one updater");
+static_assert([] {
+        std::array<int, R_SIZE> entries = {};
+        for(const PeriodicUpdate& u : periodic_updates)
+        {
+                if(u.field_update->target() == nullptr || u.min_interval_ms == 0 || u.min_interval_ms > u.max_interval_ms)
+                        return false;
+
+                ++entries[u.field_update->target() - field_buffers.data()];
+        }
+
+        return std::ranges::all_of(entries, [](const int n) { return n <= 1; });
+}(), "periodic entries need a field, sane intervals and at most one entry per field");
+static_assert(real_time_updates.size() <= MAX_HOTKEYS, "MAX_HOTKEYS too small for real_time_updates");
+static_assert(std::ranges::all_of(derived_programs, [](const ExprProgram& p) { return p.error == nullptr; }),
+              "derived_programs has an expression that does not compile");
+static_assert(std::ranges::all_of(threshold_rules, [](const ThresholdRule& r)
+{
+        return r.field >= 0 && r.field < R_SIZE && valid_color(r.color);
+}), "threshold rules need a field and a #rrggbb color");
+static_assert(sparklines.size() <= MAX_SPARKLINES && std::ranges::all_of(sparklines, [](const Sparkline& s)
+{
+        return s.field >= 0 && s.field < R_SIZE && s.min < s.max;
+}), "sparklines need a field and min < max, at most MAX_SPARKLINES of them");
+static_assert(aggregate_windows.size() <= MAX_WINDOWS && std::ranges::all_of(aggregate_windows, [](const AggregateWindow& w)
+{
+        return w.field >= 0 && w.field < R_SIZE && w.window_ms > 0;
+}), "windows need a field and a length, at most MAX_WINDOWS of them");
+
+/* running coroutines, parallel to coroutine_updates */
+static std::array<CoroutineState, coroutine_updates.size()> coroutine_states = {};
+
+/* kept-open fds of File updates, indexed by field */
+static std::array<int, R_SIZE> file_fds = [] {
+        std::array<int, R_SIZE> fds;
+        fds.fill(-1);
+        return fds;
+}();
+
+/* in-flight tracking for builtins running on the worker pool, parallel to builtin_updates */
+static std::array<BuiltinJobState, builtin_updates.size()> builtin_job_states = {};
+static_assert(sizeof(FieldBuffer) == sizeof(dwmstatus_field_buffer) &&
+              offsetof(FieldBuffer, data) == offsetof(dwmstatus_field_buffer, data) &&
+              BUFFER_MAX_SIZE == DWMSTATUS_BUFFER_MAX_SIZE,
+              "FieldBuffer must match the plugin ABI");
+static_assert(builtin_updates.size() <= POOL_RESULTS_SIZE, "every builtin must fit in the result queue");
+static_assert((POOL_RESULTS_SIZE & (POOL_RESULTS_SIZE - 1)) == 0, "POOL_RESULTS_SIZE must be a power of two");
+
+/* active tables: the compile-time config above until a config file is loaded */
+static std::unique_ptr<Config> config;
+static std::array<const FieldUpdate*, R_SIZE> field_updaters = default_updaters;  /* nullptr: field is off */
+static std::span<const PeriodicUpdate> active_periodic = periodic_updates;
+static std::span<const RealTimeUpdate> active_real_time = real_time_updates;
+static const StatusLayout* active_layout = &STATUS_LAYOUT;
+static std::span<const Page> active_pages = pages;
+static std::uint32_t page_interval_ms = PAGE_ROTATE_MS;
+
+/* visibility, the render plan is rebuilt only when it changes */
+static std::size_t current_page = 0;
+static std::uint64_t page_deadline_ms = UINT64_MAX;
+static std::uint32_t visible_fields = 0;
+static RenderPlan render_plan = default_render_plan;
+static std::uint32_t width_budget_px = STATUS_WIDTH_PX;
+
+/* threshold styling, a field is restyled only when its text changes or the rules do */
+static std::span<const ThresholdRule> active_thresholds = STATUS2D_COLORS ? std::span<const ThresholdRule>(threshold_rules) :
+                                                                          std::span<const ThresholdRule>();
+static std::vector<StyleEscape> style_escapes = make_style_escapes(active_thresholds);  /* parallel to active_thresholds */
+static std::array<int, R_SIZE> field_styles = [] {
+        std::array<int, R_SIZE> styles;
+        styles.fill(-1);  /* -1: unstyled */
+        return styles;
+}();
+
+/* sparkline rows by field, histories restart when the sparklines are reinstalled */
+static std::span<const Sparkline> active_sparklines = sparklines;
+static SparklineHistory sparkline_history;
+static std::array<int, R_SIZE> sparkline_rows = [] {
+        std::array<int, R_SIZE> rows;
+        rows.fill(-1);  /* -1: no sparkline */
+        for(std::size_t i = 0; i < sparklines.size(); ++i)
+                rows[sparklines[i].field] = int(i);
+        return rows;
+}();
+
+/* fields whose change or sample re-evaluates a derived field */
+static std::uint32_t derived_inputs = dependency_mask(default_updaters);
+
+/* sliding windows, parallel to active_windows and restarted with them */
+static std::span<const AggregateWindow> active_windows = aggregate_windows;
+static std::array<WindowState, MAX_WINDOWS> window_states;
+
+/* fields whose refreshes feed a sparkline or a window */
+static std::uint32_t sampled_fields = [] {
+        std::uint32_t mask = 0;
+        for(const Sparkline& s : sparklines)
+                mask |= 1u << s.field;
+        for(const AggregateWindow& w : aggregate_windows)
+                mask |= 1u << w.field;
+        return mask;
+}();
+
+/* scheduler state, parallel to active_periodic */
+static std::vector<PeriodicState> periodic_states;
+
+/* template function definitions */
+template<std::size_t N>
+void
+refresh_now(const std::array<int, N>& fields)
+{
+        const std::uint64_t now = monotonic_ms();
+
+        for(const int f : fields)
+        {
+                const FieldUpdate* u = field_updaters[f];
+                if(u == nullptr || !field_visible(u))
+                        continue;
+
+                const bool changed = refresh_field(u);
+
+                /* restart the periodic schedule of the field from this refresh */
+                reschedule_field(u, changed, now);
+        }
+
+        update_screen();
+}
+
+template<int... fields>
+void
+refresh_fields()
+{
+        /* procfs/sysfs reads of the group go out in one batch, everything else is refreshed in order */
+        const FieldUpdate* group[sizeof...(fields)];
+        std::size_t count = 0;
+
+        for(const int f : { fields... })
+        {
+                const FieldUpdate* u = field_updaters[f];
+                if(u == nullptr || plugin_owns(u) || !field_visible(u))
+                        continue;
+
+                if(u->type == FieldUpdate::Type::File)
+                        group[count++] = u;
+                else
+                        refresh_field(u);
+        }
+
+        bool changed[sizeof...(fields)];
+        refresh_files(group, count, changed);
+}
+
+/* function definitions */
+void
+die(const bool cond, const char* why)
+{
+        if(cond)
+                perror_exit(why);
+}
+
+ssize_t
+read_all(const int fd, void* buffer, const size_t nbytes)
+{
+        char* buf = (char*)buffer;
+        size_t read_so_far = 0;
+
+        while(read_so_far < nbytes)
+        {
+                const ssize_t rc = read(fd, buf + read_so_far, nbytes - read_so_far);
+                if(rc < 0)
+                        return rc;
+
+                if(rc == 0)
+                        break;
+
+                read_so_far += rc;
+        }
+
+        return read_so_far;
+}
+
+pid_t
+create_child(const char* cmd, const int pipe_fds[2], const bool own_group)
+{
+        const pid_t child_pid = fork();
+        die(child_pid < 0, "fork");
+
+        /* set on both sides, so a kill of the group right after fork() cannot miss it */
+        if(own_group)
+                setpgid(child_pid == 0 ? 0 : child_pid, 0);
+
+        if(child_pid == 0)
+        {
+                int rc = close(pipe_fds[0]);
+                if(rc < 0)
+                        exit(EXIT_FAILURE);
+
+                rc = dup2(pipe_fds[1], STDOUT_FILENO);
+                if(rc < 0)
+                        exit(EXIT_FAILURE);
+
+                const char* new_argv[] = SHCMD(cmd);
+                execv(new_argv[0], (char**)new_argv);
+                exit(EXIT_FAILURE);
+        }
+
+        int rc = close(pipe_fds[1]);
+        die(rc < 0, "close");
+
+        return child_pid;
+}
+
+int
+get_named_socket()
+{
+        const int sock_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        die(sock_fd < 0, "socket");
+
+        struct sockaddr_un name;
+        memset(&name, 0, sizeof(name));
+        name.sun_family = AF_UNIX;
+        strncpy(name.sun_path, SOCKET_PATH, sizeof(name.sun_path) - 1);
+
+        const int rc = bind(sock_fd, (const struct sockaddr*)&name, sizeof(name));
+        die(rc < 0, "bind");
+
+        return sock_fd;
+}
+
+void DWMSTATUS_NORETURN
+perror_exit(const char* why)
+{
+        perror(why);
+        exit(EXIT_FAILURE);
+}
+
+int
+read_cmd_output(const char* cmd, FieldBuffer* field_buffer)
+{
+        int rc;
+
+        /* create pipe */
+        int pipe_fds[2];
+        rc = pipe(pipe_fds);
+        die(rc < 0, "pipe");
+
+        /* create child */
+        const pid_t child_pid = create_child(cmd, pipe_fds, false);
+
+        auto& [len, buf] = *field_buffer;
+
+        /* read all characters from the pipe */
+        buf[len = 0] = '\0';
+        const ssize_t b_read = read_all(pipe_fds[0], buf, BUFFER_MAX_SIZE);
+        die(b_read < 0, "read");
+
+        /* null-terminate and delete trailing newline */
+        buf[len = b_read] = '\0';
+        if(len > 0 && buf[len - 1] == '\n')
+                buf[--len] = '\0';
+
+        /* cleanup */
+        /* wait for this child only, workers may be running their own (e.g. std::system) */
+        rc = close(pipe_fds[0]);
+        if(rc < 0)
+        {
+                waitpid(child_pid, nullptr, 0);
+                return rc;
+        }
+
+        rc = waitpid(child_pid, nullptr, 0);
+        if(rc < 0)
+                return rc;
+
+        return 0;
+}
+
+void
+run_update(const FieldUpdate* field_update)
+{
+        switch(field_update->type)
+        {
+        case FieldUpdate::Type::Shell:
+        {
+                auto& args = field_update->args.shell;
+                const int rc = read_cmd_output(args.command, args.field_buffer);
+                die(rc < 0, "read_cmd_output");
+
+                break;
+        }
+        case FieldUpdate::Type::Builtin:
+        {
+                auto& args = field_update->args.builtin;
+                args.fptr(args.field_buffer);
+
+                break;
+        }
+        case FieldUpdate::Type::Meta:
+        {
+                auto& args = field_update->args.meta;
+                args.fptr();
+
+                break;
+        }
+        case FieldUpdate::Type::File:
+        {
+                bool changed;
+                refresh_files(&field_update, 1, &changed);
+
+                break;
+        }
+        case FieldUpdate::Type::Coroutine:
+        {
+                start_coroutine(field_update, 0);
+
+                break;
+        }
+        case FieldUpdate::Type::Expr:
+        {
+                run_expr(field_update);
+
+                break;
+        }
+        default:
+        {
+                DWMSTATUS_UNREACHABLE;
+        }
+        }
+}
+
+bool
+refresh_field(const FieldUpdate* field_update)
+{
+        FieldBuffer* field_buffer = field_update->target();
+        if(field_buffer == nullptr)
+        {
+                run_update(field_update);
+                return true;
+        }
+
+        /* a config file may have replaced the updater of the field or turned it off */
+        field_update = active_updater(field_update);
+        if(field_update == nullptr || plugin_owns(field_update))
+                return false;
+
+        /* builtins run on the worker pool, the change is applied when the result comes back */
+        if(field_update->type == FieldUpdate::Type::Builtin)
+        {
+                pool_submit(field_update, 0);
+                return false;
+        }
+
+        if(field_update->type == FieldUpdate::Type::File)
+        {
+                bool changed;
+                refresh_files(&field_update, 1, &changed);
+                return changed;
+        }
+
+        if(field_update->type == FieldUpdate::Type::Coroutine)
+        {
+                start_coroutine(field_update, 0);
+                return false;
+        }
+
+        const FieldBuffer old = *field_buffer;
+        run_update(field_update);
+
+        return field_refreshed(field_update, &old);
+}
+
+void
+field_changed(const int field)
+{
+        dirty_widths |= 1u << field;
+        restyle_field(field);
+        refresh_dependents(field, true);
+}
+
+bool
+first_number(const FieldBuffer& field_buffer, double* value)
+{
+        const char* begin = field_buffer.data;
+        const char* end = field_buffer.data + field_buffer.length;
+
+        const char* digit = std::find_if(begin, end, [](const char c) { return c >= '0' && c <= '9'; });
+        if(digit == end)
+                return false;
+
+        if(digit > begin && digit[-1] == '-')
+                --digit;
+
+        return std::from_chars(digit, end, *value).ec == std::errc();
+}
+
+void
+restyle_field(const int field)
+{
+        field_styles[field] = -1;
+
+        double value;
+        if(active_thresholds.empty() || !first_number(field_buffers[field], &value))
+                return;
+
+        for(std::size_t i = 0; i < active_thresholds.size(); ++i)
+        {
+                const ThresholdRule& rule = active_thresholds[i];
+                if(rule.field != field)
+                        continue;
+
+                if(rule.op == ThresholdRule::Greater ? value > rule.value : value < rule.value)
+                {
+                        field_styles[field] = int(i);
+                        return;
+                }
+        }
+}
+
+void
+record_sample(const int field)
+{
+        double value;
+        if(!(sampled_fields & (1u << field)) || !first_number(field_buffers[field], &value))
+                return;
+
+        if(sparkline_rows[field] >= 0)
+                push_sparkline(sparkline_rows[field], value);
+
+        const std::uint64_t now = monotonic_ms();
+        for(std::size_t i = 0; i < active_windows.size(); ++i)
+        {
+                if(active_windows[i].field != field)
+                        continue;
+
+                window_expire(&window_states[i], now, active_windows[i].window_ms);
+                window_push(&window_states[i], now, value);
+        }
+}
+
+void
+push_sparkline(const int row, const double value)
+{
+        const Sparkline& sparkline = active_sparklines[row];
+        const double scaled = (value - sparkline.min) / (sparkline.max - sparkline.min) * 8;
+        const auto level = std::uint8_t(std::clamp(scaled, 0.0, 7.0));
+
+        SparklineHistory& h = sparkline_history;
+        h.levels[row][h.head[row]] = level;
+        h.head[row] = (h.head[row] + 1) % SPARKLINE_SAMPLES;
+
+        /* U+2581..U+2588, only the last byte differs */
+        char* glyphs = h.glyphs[row].data();
+        if(h.count[row] == SPARKLINE_SAMPLES)
+                memmove(glyphs, glyphs + 3, (SPARKLINE_SAMPLES - 1) * 3);
+        else
+                ++h.count[row];
+
+        char* glyph = glyphs + (h.count[row] - 1) * 3;
+        glyph[0] = '\xE2';
+        glyph[1] = '\x96';
+        glyph[2] = char(0x81 + level);
+
+        dirty_widths |= 1u << sparkline.field;
+}
+
+void
+window_push(WindowState* w, const std::uint64_t now_ms, const double value)
+{
+        /* a full ring drops its oldest sample, the window is then shorter than asked */
+        if(w->next_seq - w->first_seq == WINDOW_SAMPLES)
+                window_drop_oldest(w);
+
+        const std::uint64_t seq = w->next_seq++;
+        w->times_ms[seq % WINDOW_SAMPLES] = now_ms;
+        w->values[seq % WINDOW_SAMPLES] = value;
+        w->sum += value;
+
+        /* a sample that can no longer be the extreme leaves the back, each sample is popped at most once */
+        auto push = [&](MonotonicDeque* d, auto dominated)
+        {
+                while(d->count > 0 && dominated(w->values[d->seqs[(d->front + d->count - 1) % WINDOW_SAMPLES] % WINDOW_SAMPLES], value))
+                        --d->count;
+
+                d->seqs[(d->front + d->count++) % WINDOW_SAMPLES] = seq;
+        };
+
+        push(&w->min, [](const double back, const double v) { return back >= v; });
+        push(&w->max, [](const double back, const double v) { return back <= v; });
+}
+
+void
+window_drop_oldest(WindowState* w)
+{
+        const std::uint64_t seq = w->first_seq++;
+        w->sum -= w->values[seq % WINDOW_SAMPLES];
+
+        for(MonotonicDeque* d : { &w->min, &w->max })
+        {
+                if(d->count > 0 && d->seqs[d->front] == seq)
+                {
+                        d->front = (d->front + 1) % WINDOW_SAMPLES;
+                        --d->count;
+                }
+        }
+
+        /* no rounding error is carried into the next samples */
+        if(w->first_seq == w->next_seq)
+                w->sum = 0;
+}
+
+void
+window_expire(WindowState* w, const std::uint64_t now_ms, const std::uint32_t window_ms)
+{
+        while(w->first_seq < w->next_seq && w->times_ms[w->first_seq % WINDOW_SAMPLES] + window_ms <= now_ms)
+                window_drop_oldest(w);
+}
+
+bool
+window_aggregate(const std::size_t index, const int aggregate, double* value)
+{
+        if(index >= active_windows.size())
+                return false;
+
+        /* a field that stopped refreshing still ages out of its window */
+        WindowState* w = &window_states[index];
+        window_expire(w, monotonic_ms(), active_windows[index].window_ms);
+
+        const std::uint64_t count = w->next_seq - w->first_seq;
+        if(count == 0)
+                return false;
+
+        const std::size_t oldest = w->first_seq % WINDOW_SAMPLES;
+        const std::size_t newest = (w->next_seq - 1) % WINDOW_SAMPLES;
+
+        switch(aggregate)
+        {
+        case AggregateWindow::Min:
+                *value = w->values[w->min.seqs[w->min.front] % WINDOW_SAMPLES];
+                return true;
+        case AggregateWindow::Max:
+                *value = w->values[w->max.seqs[w->max.front] % WINDOW_SAMPLES];
+                return true;
+        case AggregateWindow::Avg:
+                *value = w->sum / double(count);
+                return true;
+        case AggregateWindow::Rate:
+                if(w->times_ms[newest] == w->times_ms[oldest])
+                        return false;
+
+                *value = (w->values[newest] - w->values[oldest]) * 1000 / double(w->times_ms[newest] - w->times_ms[oldest]);
+                return true;
+        default:
+                return false;
+        }
+}
+
+void
+reset_samples()
+{
+        sparkline_history = {};
+        sparkline_rows.fill(-1);
+        sampled_fields = 0;
+        for(std::size_t i = 0; i < active_sparklines.size(); ++i)
+        {
+                sparkline_rows[active_sparklines[i].field] = int(i);
+                sampled_fields |= 1u << active_sparklines[i].field;
+        }
+
+        window_states = {};
+        for(const AggregateWindow& w : active_windows)
+                sampled_fields |= 1u << w.field;
+
+        dirty_widths = ALL_FIELDS;
+}
+
+bool
+evaluate(const ExprProgram& program, double* result)
+{
+        double stack[EXPR_STACK_SIZE];
+        std::size_t top = 0;
+
+        /* a missing input, an empty window, a division by zero or a failed pos() leaves the field empty */
+        for(std::size_t i = 0; i < program.op_count; ++i)
+        {
+                const ExprProgram::Op& op = program.ops[i];
+                switch(op.code)
+                {
+                case ExprProgram::Const:
+                        stack[top++] = op.constant;
+                        break;
+                case ExprProgram::Load:
+                        if(!first_number(field_buffers[op.field], &stack[top++]))
+                                return false;
+                        break;
+                case ExprProgram::Aggregate:
+                {
+                        const auto window = std::find_if(active_windows.begin(), active_windows.end(), [&](const AggregateWindow& w)
+                        {
+                                return w.field == op.field;
+                        });
+                        if(window == active_windows.end() || !window_aggregate(window - active_windows.begin(), op.aggregate, &stack[top++]))
+                                return false;
+                        break;
+                }
+                case ExprProgram::Neg:
+                        stack[top - 1] = -stack[top - 1];
+                        break;
+                case ExprProgram::Pos:
+                        if(!(stack[top - 1] > 0))
+                                return false;
+                        break;
+                default:
+                {
+                        const double b = stack[--top];
+                        double& a = stack[top - 1];
+                        if(op.code == ExprProgram::Add)
+                                a += b;
+                        else if(op.code == ExprProgram::Sub)
+                                a -= b;
+                        else if(op.code == ExprProgram::Mul)
+                                a *= b;
+                        else if(b == 0)
+                                return false;
+                        else
+                                a /= b;
+                        break;
+                }
+                }
+        }
+
+        *result = stack[0];
+        return top == 1 && std::isfinite(*result);
+}
+
+void
+run_expr(const FieldUpdate* field_update)
+{
+        auto& args = field_update->args.expr;
+        FieldBuffer* field_buffer = args.field_buffer;
+
+        double value;
+        if(!evaluate(*args.program, &value))
+        {
+                field_buffer->length = 0;
+                field_buffer->data[0] = '\0';
+                return;
+        }
+
+        const auto res = std::to_chars(field_buffer->data, field_buffer->data + BUFFER_MAX_SIZE, value,
+                                       std::chars_format::fixed, args.program->precision);
+        field_buffer->length = res.ec == std::errc() ? res.ptr - field_buffer->data : 0;
+        field_buffer->data[field_buffer->length] = '\0';
+}
+
+bool
+refresh_dependents(const int field, const bool text_changed)
+{
+        static std::uint32_t refreshing = 0;  /* derived fields being evaluated, breaks cycles */
+
+        if(!(derived_inputs & (1u << field)))
+                return false;
+
+        bool changed = false;
+        for(int f = 0; f < R_SIZE; ++f)
+        {
+                const FieldUpdate* u = field_updaters[f];
+                if(u == nullptr || u->type != FieldUpdate::Type::Expr || (refreshing & (1u << f)))
+                        continue;
+
+                const ExprProgram* program = u->args.expr.program;
+                const std::uint32_t inputs = text_changed ? program->field_inputs | program->window_inputs : program->window_inputs;
+                if(!(inputs & (1u << field)))
+                        continue;
+
+                refreshing |= 1u << f;
+                changed = refresh_field(u) || changed;
+                refreshing &= ~(1u << f);
+        }
+
+        return changed;
+}
+
+std::uint32_t
+dependency_mask(const std::array<const FieldUpdate*, R_SIZE>& updaters)
+{
+        std::uint32_t mask = 0;
+        for(const FieldUpdate* u : updaters)
+        {
+                if(u != nullptr && u->type == FieldUpdate::Type::Expr)
+                        mask |= u->args.expr.program->field_inputs | u->args.expr.program->window_inputs;
+        }
+
+        return mask;
+}
+
+std::vector<StyleEscape>
+make_style_escapes(std::span<const ThresholdRule> rules)
+{
+        std::vector<StyleEscape> escapes(rules.size());
+        for(std::size_t i = 0; i < rules.size(); ++i)
+        {
+                const auto res = fmt::format_to_n(escapes[i].data, sizeof(escapes[i].data), "^c{}^", rules[i].color);
+                escapes[i].length = std::uint8_t(res.out - escapes[i].data);
+        }
+
+        return escapes;
+}
+
+bool
+field_refreshed(const FieldUpdate* field_update, const FieldBuffer* old)
+{
+        const FieldBuffer* field_buffer = field_update->target();
+
+        /* sparklines sample every refresh, an unchanged value is a sample too */
+        record_sample(field_buffer - field_buffers.data());
+
+        const bool changed = old->length != field_buffer->length ||
+                             memcmp(old->data, field_buffer->data, old->length) != 0;
+        if(!changed)
+        {
+                /* the windows moved even so, a derived field reading them is drawn here */
+                if(refresh_dependents(field_buffer - field_buffers.data(), false))
+                        update_screen();
+
+                return false;
+        }
+
+        field_changed(field_buffer - field_buffers.data());
+
+        for(const auto& dep : field_dependencies)
+        {
+                if(&field_buffers[dep.source] == field_buffer && field_updaters[dep.derived] != nullptr &&
+                   dep.crossed(old, field_buffer))
+                        refresh_field(field_updaters[dep.derived]);
+        }
+
+        return true;
+}
+
+const FieldUpdate*
+active_updater(const FieldUpdate* field_update)
+{
+        const FieldBuffer* field_buffer = field_update->target();
+        if(field_buffer == nullptr)
+                return field_update;
+
+        return field_updaters[field_buffer - field_buffers.data()];
+}
+
+void
+record_interactive_latency(const std::uint64_t received_us)
+{
+        const std::uint64_t latency = monotonic_us() - received_us;
+        stats.interactive_latency_us[stats.interactive_count % LATENCY_SAMPLES] =
+            std::uint32_t(std::min<std::uint64_t>(latency, UINT32_MAX));
+        ++stats.interactive_count;
+}
+
+void
+init_uring()
+{
+#ifndef NO_IO_URING
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        /* unavailable (old kernel, disabled by sysctl or seccomp) means falling back to pread() */
+        const int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+        if(fd < 0)
+                return;
+
+        /* IORING_OP_READ needs 5.6, on 5.1-5.5 every read would complete with -EINVAL;
+           the probe itself is 5.6 too, so a failing probe means the same */
+        alignas(struct io_uring_probe) char probe_buffer[sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)] = {};
+        auto* probe = (struct io_uring_probe*)probe_buffer;
+        if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+           probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+        {
+                close(fd);
+                return;
+        }
+
+        /* the one mapping below covers both rings, kernels before 5.4 want them mapped separately */
+        if(!(params.features & IORING_FEAT_SINGLE_MMAP))
+        {
+                close(fd);
+                return;
+        }
+
+        const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        const size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        const size_t ring_size = std::max(sq_size, cq_size);
+        const size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        char* ring = (char*)mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if(ring == MAP_FAILED)
+        {
+                close(fd);
+                return;
+        }
+
+        void* sqes = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if(sqes == MAP_FAILED)
+        {
+                munmap(ring, ring_size);
+                close(fd);
+                return;
+        }
+
+        uring.sq_tail  = (unsigned*)(ring + params.sq_off.tail);
+        uring.sq_mask  = (unsigned*)(ring + params.sq_off.ring_mask);
+        uring.sq_array = (unsigned*)(ring + params.sq_off.array);
+        uring.cq_head  = (unsigned*)(ring + params.cq_off.head);
+        uring.cq_tail  = (unsigned*)(ring + params.cq_off.tail);
+        uring.cq_mask  = (unsigned*)(ring + params.cq_off.ring_mask);
+        uring.cqes     = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+        uring.sqes     = (struct io_uring_sqe*)sqes;
+        uring.fd       = fd;
+#endif
+}
+
+#ifndef NO_IO_URING
+void
+read_files_uring(FileRead* reads, const std::size_t count)
+{
+        /* one io_uring_enter() per URING_ENTRIES reads, submitting and reaping together */
+        for(std::size_t next = 0; next < count;)
+        {
+                unsigned n = 0;
+                unsigned tail = *uring.sq_tail;
+                for(; next < count && n < URING_ENTRIES; ++next)
+                {
+                        FileRead& r = reads[next];
+                        if(r.fd < 0)
+                                continue;
+
+                        const unsigned idx = tail & *uring.sq_mask;
+
+                        struct io_uring_sqe* sqe = &uring.sqes[idx];
+                        memset(sqe, 0, sizeof(*sqe));
+                        sqe->opcode    = IORING_OP_READ;
+                        sqe->fd        = r.fd;
+                        sqe->addr      = (std::uint64_t)r.field_update->target()->data;
+                        sqe->len       = BUFFER_MAX_SIZE;
+                        sqe->off       = 0;
+                        sqe->user_data = next;
+
+                        uring.sq_array[idx] = idx;
+                        ++tail;
+                        ++n;
+                }
+
+                if(n == 0)
+                        break;
+
+                std::atomic_ref<unsigned>(*uring.sq_tail).store(tail, std::memory_order_release);
+
+                const int rc = syscall(__NR_io_uring_enter, uring.fd, n, n, IORING_ENTER_GETEVENTS, nullptr, 0);
+                die(rc < 0, "io_uring_enter");
+                ++stats.read_syscalls;
+
+                unsigned head = *uring.cq_head;
+                while(head != std::atomic_ref<unsigned>(*uring.cq_tail).load(std::memory_order_acquire))
+                {
+                        const struct io_uring_cqe& cqe = uring.cqes[head & *uring.cq_mask];
+                        reads[cqe.user_data].result = cqe.res;
+                        ++head;
+                }
+                std::atomic_ref<unsigned>(*uring.cq_head).store(head, std::memory_order_release);
+        }
+}
+#endif
+
+void
+read_files(FileRead* reads, const std::size_t count)
+{
+        /* procfs and sysfs regenerate the contents on every read from offset 0, so the fds stay open */
+        for(std::size_t i = 0; i < count; ++i)
+        {
+                int& fd = file_fds[reads[i].field_update->target() - field_buffers.data()];
+                if(fd < 0)
+                        fd = open(reads[i].field_update->args.file.path, O_RDONLY | O_CLOEXEC);
+
+                reads[i].fd = fd;
+                reads[i].result = -EBADF;
+                if(fd >= 0)
+                        ++stats.file_reads;
+        }
+
+#ifndef NO_IO_URING
+        if(uring.fd >= 0)
+        {
+                read_files_uring(reads, count);
+                return;
+        }
+#endif
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+                FileRead& r = reads[i];
+                if(r.fd < 0)
+                        continue;
+
+                r.result = pread(r.fd, r.field_update->target()->data, BUFFER_MAX_SIZE, 0);
+                ++stats.read_syscalls;
+        }
+}
+
+void
+refresh_files(const FieldUpdate* const* updates, const std::size_t count, bool* changed)
+{
+        std::array<FileRead, R_SIZE> reads;
+        std::array<FieldBuffer, R_SIZE> olds;
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+                olds[i] = *updates[i]->target();
+                reads[i] = { updates[i], -1, -EBADF };
+        }
+
+        read_files(reads.data(), count);
+
+        for(std::size_t i = 0; i < count; ++i)
+        {
+                const FieldUpdate* u = updates[i];
+                auto& [len, buf] = *u->target();
+
+                len = reads[i].result > 0 ? reads[i].result : 0;
+                buf[len] = '\0';
+                if(len > 0 && buf[len - 1] == '\n')
+                        buf[--len] = '\0';
+
+                if(u->args.file.parse != nullptr)
+                        u->args.file.parse(u->target());
+
+                changed[i] = field_refreshed(u, &olds[i]);
+        }
+}
+
+void
+load_plugins()
+{
+        const char* home = getenv("HOME");
+        if(home == nullptr)
+                return;
+
+        char dir_path[PATH_MAX];
+        const auto dir_res = fmt::format_to_n(dir_path, sizeof(dir_path) - 1, "{}/{}", home, PLUGIN_DIR);
+        *dir_res.out = '\0';
+
+        DIR* dir = opendir(dir_path);
+        if(dir == nullptr)
+                return;
+
+        while(const struct dirent* ent = readdir(dir))
+        {
+                const std::string_view name = ent->d_name;
+                if(!name.ends_with(".so"))
+                        continue;
+
+                if(plugin_count == plugins.size())
+                {
+                        fmt::print(stderr, "load_plugins(): More than {} plugins, ignoring {}\n", MAX_PLUGINS, name);
+                        continue;
+                }
+
+                char path[PATH_MAX];
+                const auto res = fmt::format_to_n(path, sizeof(path) - 1, "{}/{}", dir_path, name);
+                *res.out = '\0';
+
+                void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+                if(handle == nullptr)
+                {
+                        fmt::print(stderr, "dlopen(): {}\n", dlerror());
+                        continue;
+                }
+
+                const auto entry = (dwmstatus_plugin_entry_fn)dlsym(handle, "dwmstatus_plugin_entry");
+                const dwmstatus_plugin* desc = entry != nullptr ? entry() : nullptr;
+                if(desc == nullptr || desc->abi_version != DWMSTATUS_PLUGIN_ABI_VERSION || desc->update == nullptr)
+                {
+                        fmt::print(stderr, "load_plugins(): {}: missing entry point or ABI mismatch\n", name);
+                        dlclose(handle);
+                        continue;
+                }
+
+                const auto field = std::find(field_names.begin(), field_names.end(), desc->field != nullptr ? desc->field : "");
+                if(field == field_names.end() || plugin_fields[field - field_names.begin()])
+                {
+                        fmt::print(stderr, "load_plugins(): {}: unknown or already taken field\n", name);
+                        dlclose(handle);
+                        continue;
+                }
+
+                void* state = desc->init != nullptr ? desc->init() : nullptr;
+                if(desc->init != nullptr && state == nullptr)
+                {
+                        fmt::print(stderr, "load_plugins(): {}: init failed\n", name);
+                        dlclose(handle);
+                        continue;
+                }
+
+                Plugin& plugin = plugins[plugin_count];
+                plugin.dl_handle = handle;
+                plugin.desc = desc;
+                plugin.state = state;
+                plugin.field = field - field_names.begin();
+                plugin.deadline_ms = desc->interval_ms > 0 ? monotonic_ms() : UINT64_MAX;
+                plugin_fields[plugin.field] = true;
+
+                struct pollfd& pfd = pollfds[PLUGIN_POLL_BASE + plugin_count];
+                pfd.fd = desc->pollfd != nullptr ? desc->pollfd(state) : -1;
+                pfd.events = POLLIN;
+
+                ++plugin_count;
+        }
+
+        closedir(dir);
+}
+
+void
+unload_plugins()
+{
+        for(std::size_t i = 0; i < plugin_count; ++i)
+        {
+                Plugin& plugin = plugins[i];
+                if(plugin.desc->teardown != nullptr)
+                        plugin.desc->teardown(plugin.state);
+
+                dlclose(plugin.dl_handle);
+                plugin = {};
+        }
+
+        plugin_count = 0;
+}
+
+bool
+plugin_owns(const FieldUpdate* field_update)
+{
+        const FieldBuffer* field_buffer = field_update->target();
+
+        return field_buffer != nullptr && plugin_fields[field_buffer - field_buffers.data()];
+}
+
+bool
+run_plugin(Plugin* plugin)
+{
+        FieldBuffer result;
+
+        const std::uint64_t start = monotonic_us();
+        const int rc = plugin->desc->update(plugin->state, (dwmstatus_field_buffer*)&result);
+        const std::uint64_t elapsed_us = monotonic_us() - start;
+
+        ++plugin->updates;
+        plugin->total_us += elapsed_us;
+        plugin->max_us = std::max(plugin->max_us, elapsed_us);
+
+        if(rc != 0)
+                return false;
+
+        result.length = std::min<std::uint32_t>(result.length, BUFFER_MAX_SIZE);
+        result.data[result.length] = '\0';
+
+        FieldBuffer& field_buffer = field_buffers[plugin->field];
+        const bool changed = result.length != field_buffer.length ||
+                             memcmp(result.data, field_buffer.data, result.length) != 0;
+        field_buffer = result;
+        record_sample(plugin->field);
+        if(changed)
+                field_changed(plugin->field);
+        else if(refresh_dependents(plugin->field, false))
+                update_screen();
+
+        return changed;
+}
+
+int
+run_due_plugins()
+{
+        const std::uint64_t now = monotonic_ms();
+        std::uint64_t next = UINT64_MAX;
+        bool changed_any = false;
+
+        for(std::size_t i = 0; i < plugin_count; ++i)
+        {
+                Plugin& plugin = plugins[i];
+
+                /* plugins are non-essential like every other periodic field, and not polled while hidden */
+                if(screen_blanked || !(visible_fields & (1u << plugin.field)))
+                        continue;
+
+                if(plugin.deadline_ms <= now)
+                {
+                        const bool changed = run_plugin(&plugin);
+                        changed_any = changed_any || changed;
+                        plugin.deadline_ms = align_to_tick(now, plugin.desc->interval_ms);
+                }
+
+                next = std::min(next, plugin.deadline_ms);
+        }
+
+        if(changed_any)
+                update_screen();
+
+        if(next == UINT64_MAX)
+                return -1;
+
+        return next > now ? int(next - now) : 0;
+}
+
+void
+handle_plugin_events()
+{
+        bool changed_any = false;
+
+        for(std::size_t i = 0; i < plugin_count; ++i)
+        {
+                struct pollfd& pfd = pollfds[PLUGIN_POLL_BASE + i];
+                if(pfd.revents == 0)
+                        continue;
+
+                const bool changed = run_plugin(&plugins[i]);
+                changed_any = changed_any || changed;
+
+                /* a hung up or closed fd stays readable forever, the plugin is left to its interval */
+                if(pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+                {
+                        fmt::print(
+                            stderr,
+                            "handle_plugin_events(): {}: fd {} hung up or closed, no longer watched\n",
+                            plugins[i].desc->name != nullptr ? plugins[i].desc->name : "?",
+                            pfd.fd
+                        );
+                        pfd.fd = -1;
+                }
+        }
+
+        if(changed_any)
+                update_screen();
+}
+
+void
+init_pool()
+{
+        for(std::size_t i = 0; i < pool_results.cells.size(); ++i)
+                pool_results.cells[i].sequence.store(i, std::memory_order_relaxed);
+
+        pollfds[P_POOL].fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        die(pollfds[P_POOL].fd < 0, "eventfd");
+        pollfds[P_POOL].events = POLLIN;
+
+        for(std::size_t i = 0; i < workers.size(); ++i)
+                workers[i].thread = std::thread(&worker_main, i);
+}
+
+void
+stop_pool()
+{
+        pool_stopping = true;
+        pool_pending.release(workers.size());
+
+        for(auto& w : workers)
+                w.thread.join();
+}
+
+void
+worker_main(const std::size_t self)
+{
+        for(;;)
+        {
+                /* one permit per queued job, so a job is guaranteed to be somewhere after acquiring */
+                pool_pending.acquire();
+                if(pool_stopping)
+                        return;
+
+                PoolJob job;
+                while(!pool_take(self, &job))
+                        std::this_thread::yield();
+
+                /* the builtin writes straight into the back slot, no copy and no lock */
+                const FieldUpdate* u = job.field_update;
+                FieldPublication* publication = &builtin_job_states[u - builtin_updates.data()].publication;
+
+                u->args.builtin.fptr(publication_back(publication));
+                publication_publish(publication);
+
+                publish_result({ u, job.received_us });
+        }
+}
+
+bool
+pool_take(const std::size_t self, PoolJob* job)
+{
+        {
+                Worker& own = workers[self];
+                const std::lock_guard<std::mutex> guard(own.lock);
+                if(!own.jobs.empty())
+                {
+                        *job = own.jobs.back();
+                        own.jobs.pop_back();
+                        return true;
+                }
+        }
+
+        for(std::size_t i = 1; i < workers.size(); ++i)
+        {
+                Worker& victim = workers[(self + i) % workers.size()];
+                const std::lock_guard<std::mutex> guard(victim.lock);
+                if(!victim.jobs.empty())
+                {
+                        *job = victim.jobs.front();
+                        victim.jobs.pop_front();
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+void
+pool_submit(const FieldUpdate* field_update, const std::uint64_t received_us)
+{
+        /* at most one job per builtin is in flight, so builtins may keep static state without locking */
+        BuiltinJobState& state = builtin_job_states[field_update - builtin_updates.data()];
+        if(state.in_flight)
+        {
+                ++state.reruns;
+                if(received_us != 0 && state.received_us == 0)
+                        state.received_us = received_us;
+
+                return;
+        }
+
+        state.in_flight = true;
+
+        Worker& w = workers[pool_next++ % workers.size()];
+        {
+                const std::lock_guard<std::mutex> guard(w.lock);
+                w.jobs.push_back({ field_update, received_us });
+        }
+
+        pool_pending.release();
+}
+
+FieldBuffer*
+publication_back(FieldPublication* publication)
+{
+        return &publication->slots[publication->back];
+}
+
+void
+publication_publish(FieldPublication* publication)
+{
+        /* hand the written slot over and take the previous middle one as the next back slot */
+        const std::uint8_t old = publication->middle.exchange(
+                                     publication->back | FieldPublication::DIRTY,
+                                     std::memory_order_acq_rel
+                                 );
+        publication->back = old & FieldPublication::INDEX_MASK;
+}
+
+const FieldBuffer*
+publication_consume(FieldPublication* publication)
+{
+        if(publication->middle.load(std::memory_order_relaxed) & FieldPublication::DIRTY)
+        {
+                const std::uint8_t old = publication->middle.exchange(
+                                             publication->front,
+                                             std::memory_order_acq_rel
+                                         );
+                publication->front = old & FieldPublication::INDEX_MASK;
+        }
+
+        return &publication->slots[publication->front];
+}
+
+void
+publish_result(const PoolResult& result)
+{
+        for(;;)
+        {
+                std::size_t pos = pool_results.enqueue_pos.load(std::memory_order_relaxed);
+                auto& cell = pool_results.cells[pos & (POOL_RESULTS_SIZE - 1)];
+                const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+
+                if(seq == pos)
+                {
+                        if(pool_results.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                                cell.result = result;
+                                cell.sequence.store(pos + 1, std::memory_order_release);
+                                break;
+                        }
+                }
+                else
+                {
+                        /* full, cannot happen while in-flight jobs are bounded by builtin_updates.size() */
+                        std::this_thread::yield();
+                }
+        }
+
+        const std::uint64_t one = 1;
+        const ssize_t rc = write(pollfds[P_POOL].fd, &one, sizeof(one));
+        (void)rc;
+}
+
+bool
+pop_result(PoolResult* result)
+{
+        const std::size_t pos = pool_results.dequeue_pos;
+        auto& cell = pool_results.cells[pos & (POOL_RESULTS_SIZE - 1)];
+
+        if(cell.sequence.load(std::memory_order_acquire) != pos + 1)
+                return false;
+
+        *result = cell.result;
+        cell.sequence.store(pos + POOL_RESULTS_SIZE, std::memory_order_release);
+        pool_results.dequeue_pos = pos + 1;
+
+        return true;
+}
+
+void
+drain_pool_results()
+{
+        std::uint64_t count;
+        const ssize_t rc = read(pollfds[P_POOL].fd, &count, sizeof(count));
+        (void)rc;
+
+        bool changed_any = false;
+        bool interactive = false;
+        const std::uint64_t now = monotonic_ms();
+
+        PoolResult result;
+        while(pop_result(&result))
+        {
+                const FieldUpdate* u = result.field_update;
+
+                BuiltinJobState& state = builtin_job_states[u - builtin_updates.data()];
+                const FieldBuffer* result_buffer = publication_consume(&state.publication);
+
+                /* dropped if a config reload took the field away while the job ran */
+                if(active_updater(u) == u)
+                {
+                        FieldBuffer* field_buffer = u->target();
+                        const FieldBuffer old = *field_buffer;
+                        *field_buffer = *result_buffer;
+
+                        const bool changed = field_refreshed(u, &old);
+                        changed_any = changed_any || changed;
+
+                        reschedule_field(u, changed, now);
+                }
+
+                if(result.received_us != 0)
+                {
+                        interactive = true;
+                        update_screen();
+                        record_interactive_latency(result.received_us);
+                }
+
+                state.in_flight = false;
+                if(state.reruns > 0)
+                {
+                        /* every queued rerun is recorded, timed from the oldest request still waiting */
+                        const std::uint64_t received_us = --state.reruns > 0 ? state.received_us : std::exchange(state.received_us, 0);
+                        pool_submit(u, received_us);
+                }
+        }
+
+        if(changed_any && !interactive)
+                update_screen();
+}
+
+std::uint64_t
+monotonic_ms()
+{
+        return clock_ms(CLOCK_MONOTONIC);
+}
+
+std::uint64_t
+monotonic_us()
+{
+        struct timespec ts;
+        const int rc = clock_gettime(CLOCK_MONOTONIC, &ts);
+        die(rc < 0, "clock_gettime");
+
+        return std::uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+std::uint64_t
+clock_ms(const clockid_t clock)
+{
+        struct timespec ts;
+        const int rc = clock_gettime(clock, &ts);
+        die(rc < 0, "clock_gettime");
+
+        return std::uint64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::uint64_t
+align_to_tick(const std::uint64_t now, const std::uint64_t interval_ms)
+{
+        /* round to the nearest tick so unrelated fields due around the same time share one wakeup;
+           rounding up would push a field refreshed just after its tick a whole tick late every time */
+        if(interval_ms < TICK_MS)
+                return now + interval_ms;
+
+        return (now + interval_ms + TICK_MS / 2) / TICK_MS * TICK_MS;
+}
+
+std::uint32_t
+interval_multiplier(const PeriodicUpdate& u)
+{
+        /* a fixed rate (min == max, e.g. a clock with seconds) is part of what the field shows */
+        return on_battery && u.min_interval_ms != u.max_interval_ms ? BATTERY_INTERVAL_MULTIPLIER : 1;
+}
+
+bool
+read_on_battery()
+{
+        if(ac_online_fd < 0)
+                return false;
+
+        char c;
+        const ssize_t rc = pread(ac_online_fd, &c, 1, 0);
+
+        return rc == 1 && c == '0';
+}
+
+void
+update_power_state(const std::uint64_t now)
+{
+        const bool battery = read_on_battery();
+        if(battery == on_battery)
+                return;
+
+        on_battery = battery;
+
+        for(std::size_t i = 0; i < periodic_states.size(); ++i)
+        {
+                /* leave parked entries (in flight or owned by a plugin) alone */
+                PeriodicState& state = periodic_states[i];
+                if(state.deadline_ms != UINT64_MAX)
+                        state.deadline_ms = align_to_tick(now, std::uint64_t(state.interval_ms) * interval_multiplier(active_periodic[i]));
+        }
+}
+
+void
+init_power()
+{
+        /* no adapter (e.g. a desktop) means always on AC */
+        ac_online_fd = open(AC_ONLINE_PATH, O_RDONLY | O_CLOEXEC);
+        on_battery = read_on_battery();
+
+        const int rc = prctl(PR_SET_TIMERSLACK, TIMER_SLACK_NS, 0, 0, 0);
+        die(rc < 0, "prctl");
+}
+
+void
+arm_clock_timer()
+{
+        /* never expires, only used to get ECANCELED when CLOCK_REALTIME is set (including on resume) */
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = std::numeric_limits<time_t>::max();
+
+        const int rc = timerfd_settime(
+                           pollfds[P_CLOCK].fd,
+                           TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                           &its,
+                           nullptr
+                       );
+        die(rc < 0, "timerfd_settime");
+}
+
+void
+init_clock_watch()
+{
+        suspended_ms = clock_ms(CLOCK_BOOTTIME) - clock_ms(CLOCK_MONOTONIC);
+
+        pollfds[P_CLOCK].fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        die(pollfds[P_CLOCK].fd < 0, "timerfd_create");
+        pollfds[P_CLOCK].events = POLLIN;
+        arm_clock_timer();
+
+        /* /etc/localtime is usually replaced rather than written, so watch the directory */
+        const int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        die(ifd < 0, "inotify_init1");
+
+        const int wd = inotify_add_watch(
+                           ifd,
+                           ZONEINFO_DIR,
+                           IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE | IN_ATTRIB
+                       );
+        if(wd < 0)
+        {
+                perror("inotify_add_watch");
+                close(ifd);
+                return;
+        }
+
+        pollfds[P_TZ].fd = ifd;
+        pollfds[P_TZ].events = POLLIN;
+}
+
+void
+handle_clock_timer()
+{
+        std::uint64_t expirations;
+
+        const ssize_t rc = read(pollfds[P_CLOCK].fd, &expirations, sizeof(expirations));
+        if(rc < 0 && errno == ECANCELED)
+        {
+                clock_changed = true;
+                arm_clock_timer();
+        }
+}
+
+void
+handle_tz_events()
+{
+        alignas(struct inotify_event) char buf[4096];
+
+        ssize_t len;
+        while((len = read(pollfds[P_TZ].fd, buf, sizeof(buf))) > 0)
+        {
+                for(ssize_t off = 0; off < len;)
+                {
+                        const auto* ev = (const struct inotify_event*)(buf + off);
+                        if(ev->len > 0 && strcmp(ev->name, ZONEINFO_NAME) == 0)
+                        {
+                                tzset();
+                                clock_changed = true;
+                        }
+
+                        off += sizeof(struct inotify_event) + ev->len;
+                }
+        }
+}
+
+void
+init_netlink()
+{
+        /* without rtnetlink every interface but loopback is shown, up or not */
+        const int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+        struct sockaddr_nl addr = {};
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_LINK;
+
+        if(fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+                perror("init_netlink");
+                if(fd >= 0)
+                        close(fd);
+
+                struct if_nameindex* names = if_nameindex();
+                for(struct if_nameindex* n = names; n != nullptr && n->if_index != 0; ++n)
+                {
+                        LinkInfo& link = links.emplace_back(LinkInfo{ int(n->if_index), {}, IFF_UP | IFF_RUNNING });
+                        strncpy(link.name.data(), n->if_name, IFNAMSIZ - 1);
+                        if(strcmp(n->if_name, "lo") == 0)
+                                link.flags |= IFF_LOOPBACK;
+                }
+                if_freenameindex(names);
+
+                publish_net_links();
+                return;
+        }
+
+        /* the dump is answered through the same socket as the events */
+        struct {
+                struct nlmsghdr header;
+                struct ifinfomsg info;
+        } request = {};
+        request.header.nlmsg_len = sizeof(request);
+        request.header.nlmsg_type = RTM_GETLINK;
+        request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        request.info.ifi_family = AF_UNSPEC;
+
+        if(send(fd, &request, sizeof(request), 0) < 0)
+                perror("init_netlink: send");
+
+        pollfds[P_NETLINK].fd = fd;
+        pollfds[P_NETLINK].events = POLLIN;
+}
+
+void
+handle_netlink_events()
+{
+        alignas(struct nlmsghdr) char buf[8192];
+        bool changed = false;
+
+        ssize_t len;
+        while((len = recv(pollfds[P_NETLINK].fd, buf, sizeof(buf), 0)) > 0)
+        {
+                for(auto* header = (struct nlmsghdr*)buf; NLMSG_OK(header, len); header = NLMSG_NEXT(header, len))
+                {
+                        if(header->nlmsg_type != RTM_NEWLINK && header->nlmsg_type != RTM_DELLINK)
+                                continue;
+
+                        const auto* info = (const struct ifinfomsg*)NLMSG_DATA(header);
+                        const auto it = std::find_if(links.begin(), links.end(), [&](const LinkInfo& l) { return l.index == info->ifi_index; });
+
+                        if(header->nlmsg_type == RTM_DELLINK)
+                        {
+                                if(it != links.end())
+                                        links.erase(it);
+
+                                changed = true;
+                                continue;
+                        }
+
+                        LinkInfo& link = it != links.end() ? *it : links.emplace_back(LinkInfo{ info->ifi_index, {}, 0 });
+                        link.flags = info->ifi_flags;
+
+                        int attr_len = IFLA_PAYLOAD(header);
+                        for(auto* attr = IFLA_RTA(info); RTA_OK(attr, attr_len); attr = RTA_NEXT(attr, attr_len))
+                        {
+                                if(attr->rta_type == IFLA_IFNAME)
+                                        strncpy(link.name.data(), (const char*)RTA_DATA(attr), IFNAMSIZ - 1);
+                        }
+
+                        changed = true;
+                }
+        }
+
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+                /* ENOBUFS drops events, start over from a fresh dump */
+                perror("handle_netlink_events");
+                close(pollfds[P_NETLINK].fd);
+                pollfds[P_NETLINK].fd = -1;
+                links.clear();
+                init_netlink();
+        }
+
+        /* the set changed, redraw now rather than at the next poll; a hidden field catches up once shown */
+        if(changed && publish_net_links() && field_updaters[R_NET] != nullptr)
+        {
+                if(visible_fields & (1u << R_NET))
+                        refresh_field(field_updaters[R_NET]);
+                else
+                        net_links_stale = true;
+        }
+}
+
+bool
+publish_net_links()
+{
+        NetLinks next;
+        for(const LinkInfo& link : links)
+        {
+                const std::string_view name = link.name.data();
+                bool wanted = (link.flags & IFF_UP) && (link.flags & IFF_RUNNING);
+                if(NET_INTERFACES.empty())
+                {
+                        wanted = wanted && !(link.flags & IFF_LOOPBACK);
+                }
+                else
+                {
+                        bool listed = false;
+                        for(std::string_view rest = NET_INTERFACES; !rest.empty() && !listed;)
+                        {
+                                const std::size_t end = std::min(rest.find(' '), rest.size());
+                                listed = rest.substr(0, end) == name;
+                                rest.remove_prefix(std::min(end + 1, rest.size()));
+                        }
+                        wanted = wanted && listed;
+                }
+
+                if(wanted && next.count < MAX_NET_LINKS)
+                        next.names[next.count++] = link.name;
+        }
+
+        {
+                const std::lock_guard<std::mutex> guard(net_links_lock);
+                if(next.count == net_links.count && next.names == net_links.names)
+                        return false;
+
+                net_links = next;
+        }
+
+        net_links_generation.fetch_add(1, std::memory_order_release);
+        return true;
+}
+
+void
+init_psi()
+{
+        for(std::size_t i = 0; i < PSI_PATHS.size(); ++i)
+        {
+                /* the trigger lives as long as the fd, the kernel reports it with POLLPRI */
+                const int fd = open(PSI_PATHS[i], O_RDWR | O_NONBLOCK | O_CLOEXEC);
+                if(fd < 0 || write(fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0)
+                {
+                        perror(PSI_PATHS[i]);
+                        if(fd >= 0)
+                                close(fd);
+                        continue;
+                }
+
+                pollfds[P_PSI_CPU + i].fd = fd;
+                pollfds[P_PSI_CPU + i].events = POLLPRI;
+        }
+
+        psi_triggers = all_psi_triggers();
+        if(!psi_triggers)
+                psi_deadline_ms = monotonic_ms() + PSI_FALLBACK_MS;
+}
+
+void
+init_block_devices()
+{
+        /* by name through sysfs, or the devices the mountpoints live on */
+        for(std::string_view rest = DIO_DEVICES.empty() ? DISK_MOUNTS : DIO_DEVICES; !rest.empty();)
+        {
+                const std::size_t end = std::min(rest.find(' '), rest.size());
+                const std::string name(rest.substr(0, end));
+                rest.remove_prefix(std::min(end + 1, rest.size()));
+                if(name.empty())
+                        continue;
+
+                if(DIO_DEVICES.empty())
+                {
+                        const dev_t dev = mount_source_device(name.c_str());
+                        if(dev != 0)
+                                add_block_device(dev);
+                        else
+                                fmt::print(stderr, "init_block_devices(): {}: no block device behind it, set DIO_DEVICES\n", name);
+
+                        continue;
+                }
+
+                char path[PATH_MAX];
+                const auto res = fmt::format_to_n(path, sizeof(path) - 1, "/sys/class/block/{}/dev", name);
+                *res.out = '\0';
+
+                unsigned major_id;
+                unsigned minor_id;
+                FILE* fp = fopen(path, "re");
+                if(fp != nullptr && fscanf(fp, "%u:%u", &major_id, &minor_id) == 2)
+                        add_block_device(makedev(major_id, minor_id));
+                else
+                        perror(path);
+
+                if(fp != nullptr)
+                        fclose(fp);
+        }
+}
+
+dev_t
+mount_source_device(const char* path)
+{
+        struct stat st;
+        if(stat(path, &st) < 0)
+        {
+                perror(path);
+                return 0;
+        }
+
+        /* btrfs, overlayfs and tmpfs give files an anonymous 0:N st_dev that /proc/diskstats does not list,
+           the source of the mount with that st_dev names the real device when there is one */
+        FILE* fp = fopen(MOUNTINFO_PATH, "re");
+        if(fp == nullptr)
+        {
+                perror(MOUNTINFO_PATH);
+                return major(st.st_dev) != 0 ? st.st_dev : 0;
+        }
+
+        dev_t dev = major(st.st_dev) != 0 ? st.st_dev : 0;
+        char* line = nullptr;
+        size_t cap = 0;
+        while(getline(&line, &cap, fp) >= 0)
+        {
+                /* "id parent major:minor root mountpoint options [optional fields] - fstype source superoptions" */
+                unsigned major_id;
+                unsigned minor_id;
+                if(sscanf(line, "%*u %*u %u:%u", &major_id, &minor_id) != 2 || makedev(major_id, minor_id) != st.st_dev)
+                        continue;
+
+                const char* fields_end = strstr(line, " - ");
+                char source[PATH_MAX];
+                struct stat source_st;
+                if(fields_end != nullptr && sscanf(fields_end + 3, "%*s %4095s", source) == 1 &&
+                   stat(source, &source_st) == 0 && S_ISBLK(source_st.st_mode))
+                        dev = source_st.st_rdev;  /* the last match wins, later mounts cover earlier ones */
+        }
+
+        free(line);
+        fclose(fp);
+
+        return dev;
+}
+
+void
+add_block_device(const dev_t dev)
+{
+        BlockDevices& d = block_devices;
+        for(std::size_t i = 0; i < d.count; ++i)
+        {
+                if(d.major[i] == major(dev) && d.minor[i] == minor(dev))
+                        return;
+        }
+
+        if(d.count == MAX_BLOCK_DEVICES)
+                return;
+
+        /* the name is filled in from the first diskstats line of the device */
+        d.major[d.count] = major(dev);
+        d.minor[d.count] = minor(dev);
+        ++d.count;
+}
+
+void
+handle_psi_events()
+{
+        for(std::size_t i = 0; i < PSI_PATHS.size(); ++i)
+        {
+                /* POLLERR: the pressure file went away with its cgroup, POLLNVAL: the fd is not open anymore */
+                pollfd& pfd = pollfds[P_PSI_CPU + i];
+                if(pfd.revents & (POLLERR | POLLNVAL))
+                {
+                        fmt::print(stderr, "handle_psi_events(): {}: trigger lost\n", PSI_PATHS[i]);
+                        close(pfd.fd);
+                        pfd.fd = -1;
+                }
+        }
+
+        psi_triggers = all_psi_triggers();
+
+        const std::uint64_t now = monotonic_ms();
+        psi_settle_until_ms = now + PSI_SETTLE_MS;
+        psi_deadline_ms = now + (psi_triggers ? PSI_RECHECK_MS : PSI_FALLBACK_MS);
+
+        if(field_updaters[R_PSI] != nullptr)
+                refresh_field(field_updaters[R_PSI]);
+}
+
+bool
+all_psi_triggers()
+{
+        /* a file without a live trigger is only read when another one fires, so anything less is polled */
+        return std::all_of(
+                   pollfds.begin() + P_PSI_CPU,
+                   pollfds.begin() + P_PSI_IO + 1,
+                   [](const pollfd& pfd) { return pfd.fd >= 0; }
+               );
+}
+
+void
+recheck_psi()
+{
+        if(field_updaters[R_PSI] != nullptr)
+                refresh_field(field_updaters[R_PSI]);
+
+        const std::uint64_t now = monotonic_ms();
+        if(!psi_triggers)
+                psi_deadline_ms = now + PSI_FALLBACK_MS;
+        else
+                psi_deadline_ms = now < psi_settle_until_ms ? now + PSI_RECHECK_MS : UINT64_MAX;
+}
+
+bool
+detect_resume()
+{
+        /* CLOCK_MONOTONIC stops during suspend while CLOCK_BOOTTIME keeps counting */
+        const std::uint64_t suspended = clock_ms(CLOCK_BOOTTIME) - clock_ms(CLOCK_MONOTONIC);
+        const bool resumed = suspended > suspended_ms + RESUME_THRESHOLD_MS;
+
+        suspended_ms = suspended;
+        return resumed;
+}
+
+void
+init_scheduler()
+{
+        const std::uint64_t now = monotonic_ms();
+
+        stats.start_ms = now;
+        periodic_states.assign(active_periodic.size(), {});
+
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                periodic_states[i].interval_ms = active_periodic[i].min_interval_ms;
+                periodic_states[i].deadline_ms = align_to_tick(
+                                                     now, std::uint64_t(periodic_states[i].interval_ms) * interval_multiplier(active_periodic[i])
+                                                 );
+
+                /* fields taken over by a plugin are never polled */
+                if(plugin_owns(active_periodic[i].field_update))
+                        periodic_states[i].deadline_ms = UINT64_MAX;
+        }
+}
+
+void
+reschedule(const std::size_t idx, const bool changed, const std::uint64_t now)
+{
+        const PeriodicUpdate& u = active_periodic[idx];
+        PeriodicState& state = periodic_states[idx];
+
+        /* snap back to the fastest rate on change, back off exponentially while the value is stable */
+        if(changed)
+        {
+                state.unchanged_count = 0;
+                state.interval_ms = u.min_interval_ms;
+        }
+        else
+        {
+                ++state.unchanged_count;
+                state.interval_ms = std::min<std::uint64_t>(
+                                        std::uint64_t(state.interval_ms) * 2,
+                                        u.max_interval_ms
+                                    );
+        }
+
+        state.deadline_ms = align_to_tick(now, std::uint64_t(state.interval_ms) * interval_multiplier(u));
+}
+
+void
+reschedule_field(const FieldUpdate* field_update, const bool changed, const std::uint64_t now)
+{
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                if(active_periodic[i].field_update->target() == field_update->target())
+                        reschedule(i, changed, now);
+        }
+}
+
+std::string_view
+next_token(std::string_view* line)
+{
+        const std::size_t start = line->find_first_not_of(" \t");
+        if(start == std::string_view::npos)
+        {
+                *line = {};
+                return {};
+        }
+
+        const std::size_t end = std::min(line->find_first_of(" \t", start), line->size());
+        const std::string_view token = line->substr(start, end - start);
+        line->remove_prefix(end);
+
+        return token;
+}
+
+bool
+parse_u32(const std::string_view token, std::uint32_t* value)
+{
+        const auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), *value);
+
+        return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+bool
+parse_double(const std::string_view token, double* value)
+{
+        const auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), *value);
+
+        return !token.empty() && ec == std::errc() && ptr == token.data() + token.size();
+}
+
+const char*
+parse_config_line(std::string_view line, ConfigSpec* spec)
+{
+        const std::string_view keyword = next_token(&line);
+        if(keyword.empty() || keyword[0] == '#')
+                return nullptr;
+
+        if(keyword == "format")
+        {
+                /* split at the slots into the same render plan the compiled-in layout produces */
+                const std::string_view format = line.substr(std::min(line.find_first_not_of(" \t"), line.size()));
+                if(const char* error = format_error(format); error != nullptr)
+                        return error;
+
+                if(make_render_plan(layout_from_format(format)).error != nullptr)
+                        return "format: too long";
+
+                spec->status_fmt = format;
+                return nullptr;
+        }
+
+        if(keyword == "hotkey")
+        {
+                /* hotkey <id> <field|quit|refresh|stats|page> [interactive|background] */
+                HotkeySpec hotkey = { 0, -1, nullptr, RealTimeUpdate::Interactive };
+                if(!parse_u32(next_token(&line), &hotkey.id) || hotkey.id >= MAX_HOTKEYS)
+                        return "hotkey: bad id";
+
+                const std::string_view target = next_token(&line);
+                const auto field = std::find(field_names.begin(), field_names.end(), target);
+                if(field != field_names.end())
+                        hotkey.field = int(field - field_names.begin());
+                else if(target == "refresh")
+                        hotkey.field_update = &meta_updates[0];
+                else if(target == "quit")
+                        hotkey.field_update = &meta_updates[1];
+                else if(target == "stats")
+                        hotkey.field_update = &meta_updates[2];
+                else if(target == "page")
+                        hotkey.field_update = &meta_updates[3];
+                else
+                        return "hotkey: unknown target";
+
+                const std::string_view priority = next_token(&line);
+                if(priority == "background")
+                        hotkey.priority = RealTimeUpdate::Background;
+                else if(!priority.empty() && priority != "interactive")
+                        return "hotkey: unknown priority";
+
+                spec->hotkeys.push_back(hotkey);
+                return nullptr;
+        }
+
+        if(keyword == "page")
+        {
+                /* page <name> <field>... */
+                PageSpec page = { std::string(next_token(&line)), 0 };
+                if(page.name.empty())
+                        return "page: missing name";
+
+                for(std::string_view name = next_token(&line); !name.empty(); name = next_token(&line))
+                {
+                        const auto field = std::find(field_names.begin(), field_names.end(), name);
+                        if(field == field_names.end())
+                                return "page: unknown field";
+
+                        page.fields |= 1u << (field - field_names.begin());
+                }
+
+                spec->pages.push_back(std::move(page));
+                return nullptr;
+        }
+
+        if(keyword == "threshold")
+        {
+                /* threshold <field> above|below <value> <#rrggbb> */
+                const auto field = std::find(field_names.begin(), field_names.end(), next_token(&line));
+                if(field == field_names.end())
+                        return "threshold: unknown field";
+
+                ThresholdSpec threshold = { int(field - field_names.begin()), ThresholdRule::Greater, 0, {} };
+                const std::string_view op = next_token(&line);
+                if(op == "below")
+                        threshold.op = ThresholdRule::Less;
+                else if(op != "above")
+                        return "threshold: expected above or below";
+
+                if(!parse_double(next_token(&line), &threshold.value))
+                        return "threshold: bad value";
+
+                threshold.color = next_token(&line);
+                if(!valid_color(threshold.color))
+                        return "threshold: color must be #rrggbb";
+
+                spec->thresholds.push_back(std::move(threshold));
+                return nullptr;
+        }
+
+        if(keyword == "sparkline")
+        {
+                /* sparkline <field> <min> <max> */
+                const auto field = std::find(field_names.begin(), field_names.end(), next_token(&line));
+                if(field == field_names.end())
+                        return "sparkline: unknown field";
+
+                SparklineSpec sparkline = { int(field - field_names.begin()), 0, 0 };
+                const std::string_view min = next_token(&line);
+                const std::string_view max = next_token(&line);
+                if(!parse_double(min, &sparkline.min) || !parse_double(max, &sparkline.max) || sparkline.min >= sparkline.max)
+                        return "sparkline: bad range";
+
+                if(spec->sparklines.size() == MAX_SPARKLINES)
+                        return "sparkline: more than MAX_SPARKLINES";
+
+                spec->sparklines.push_back(sparkline);
+                return nullptr;
+        }
+
+        if(keyword == "window")
+        {
+                /* window <field> <ms> */
+                const auto field = std::find(field_names.begin(), field_names.end(), next_token(&line));
+                if(field == field_names.end())
+                        return "window: unknown field";
+
+                WindowSpec window = { int(field - field_names.begin()), 0 };
+                if(!parse_u32(next_token(&line), &window.window_ms) || window.window_ms == 0)
+                        return "window: bad length";
+
+                if(spec->windows.size() == MAX_WINDOWS)
+                        return "window: more than MAX_WINDOWS";
+
+                spec->windows.push_back(window);
+                return nullptr;
+        }
+
+        if(keyword == "width")
+        {
+                /* width <px>, 0 for no budget */
+                if(!parse_u32(next_token(&line), &spec->width_budget_px))
+                        return "width: bad width";
+
+                return nullptr;
+        }
+
+        if(keyword == "page_interval")
+        {
+                /* page_interval <ms>, 0 to change pages only on the hotkey */
+                if(!parse_u32(next_token(&line), &spec->page_interval_ms))
+                        return "page_interval: bad interval";
+
+                return nullptr;
+        }
+
+        if(keyword != "field")
+                return "unknown keyword";
+
+        /* field <name> off | field <name> default|shell|file <min ms> <max ms> [command|path] | field <name> expr ... */
+        const auto name = std::find(field_names.begin(), field_names.end(), next_token(&line));
+        if(name == field_names.end())
+                return "field: unknown name";
+
+        FieldSpec& field = spec->fields[name - field_names.begin()];
+        field = {};
+
+        const std::string_view kind = next_token(&line);
+        if(kind == "off")
+        {
+                field.kind = FieldSpec::Off;
+                return nullptr;
+        }
+
+        if(kind == "default")
+                field.kind = FieldSpec::Default;
+        else if(kind == "shell")
+                field.kind = FieldSpec::Shell;
+        else if(kind == "file")
+                field.kind = FieldSpec::File;
+        else if(kind == "expr")
+                field.kind = FieldSpec::Expr;
+        else
+                return "field: unknown kind";
+
+        /* fields that are off unless configured have no compiled-in updater to fall back to */
+        if(field.kind == FieldSpec::Default && default_updaters[name - field_names.begin()] == nullptr)
+                return "field: no default updater";
+
+        if(field.kind == FieldSpec::Expr)
+        {
+                /* field <name> expr <decimals> <expression>, evaluated when an input changes */
+                std::uint32_t precision;
+                if(!parse_u32(next_token(&line), &precision) || precision > 6)
+                        return "field: bad decimals";
+
+                field.arg = line.substr(std::min(line.find_first_not_of(" \t"), line.size()));
+                field.program = compile_expression(field.arg, precision);
+
+                return field.program.error;
+        }
+
+        /* 0 0 keeps the field out of the periodic schedule */
+        field.periodic = true;
+        if(!parse_u32(next_token(&line), &field.min_interval_ms) ||
+           !parse_u32(next_token(&line), &field.max_interval_ms) ||
+           field.min_interval_ms > field.max_interval_ms ||
+           (field.min_interval_ms == 0) != (field.max_interval_ms == 0))
+                return "field: bad intervals";
+
+        if(field.kind == FieldSpec::Shell)
+                field.arg = line.substr(std::min(line.find_first_not_of(" \t"), line.size()));
+        else if(field.kind == FieldSpec::File)
+                field.arg = next_token(&line);
+
+        if(field.kind != FieldSpec::Default && field.arg.empty())
+                return "field: missing command or path";
+
+        return nullptr;
+}
+
+bool
+parse_config(const char* path, ConfigSpec* spec)
+{
+        FILE* fp = fopen(path, "re");
+        if(fp == nullptr)
+                return false;
+
+        char* line = nullptr;
+        std::size_t cap = 0;
+        std::size_t lineno = 0;
+        bool ok = true;
+
+        ssize_t len;
+        while(ok && (len = getline(&line, &cap, fp)) >= 0)
+        {
+                ++lineno;
+                if(len > 0 && line[len - 1] == '\n')
+                        line[--len] = '\0';
+
+                const char* error = parse_config_line(std::string_view(line, len), spec);
+                if(error != nullptr)
+                {
+                        fmt::print(stderr, "parse_config(): {}:{}: {}\n", path, lineno, error);
+                        ok = false;
+                }
+        }
+
+        free(line);
+        fclose(fp);
+
+        return ok;
+}
+
+std::unique_ptr<Config>
+build_config(const ConfigSpec& spec)
+{
+        auto next = std::make_unique<Config>();
+        next->updates.reserve(R_SIZE);
+        next->updaters = default_updaters;
+
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                const FieldSpec& field = spec.fields[f];
+                const FieldUpdate* compiled = default_updaters[f];
+
+                switch(field.kind)
+                {
+                case FieldSpec::Shell:
+                {
+                        const char* command = next->strings.emplace_back(field.arg).c_str();
+                        next->updaters[f] = &next->updates.emplace_back(command, &field_buffers[f]);
+
+                        break;
+                }
+                case FieldSpec::File:
+                {
+                        /* keep the compiled-in post-processing of file fields, e.g. parse_load */
+                        const char* path = next->strings.emplace_back(field.arg).c_str();
+                        auto parse = compiled != nullptr && compiled->type == FieldUpdate::Type::File ? compiled->args.file.parse : nullptr;
+                        next->updaters[f] = &next->updates.emplace_back(path, parse, &field_buffers[f]);
+
+                        break;
+                }
+                case FieldSpec::Expr:
+                {
+                        /* not polled, evaluated when an input changes */
+                        const ExprProgram* program = &next->programs.emplace_back(field.program);
+                        next->updaters[f] = &next->updates.emplace_back(program, &field_buffers[f]);
+
+                        continue;
+                }
+                case FieldSpec::Off:
+                {
+                        next->updaters[f] = nullptr;
+                        continue;
+                }
+                default:
+                {
+                        break;
+                }
+                }
+
+                if(field.periodic)
+                {
+                        if(field.min_interval_ms > 0)
+                                next->periodic.push_back({ next->updaters[f], field.min_interval_ms, field.max_interval_ms, false });
+
+                        continue;
+                }
+
+                for(const PeriodicUpdate& u : periodic_updates)
+                {
+                        if(u.field_update->target() == &field_buffers[f])
+                                next->periodic.push_back(u);
+                }
+        }
+
+        /* essential stays a compile-time property of the field */
+        for(PeriodicUpdate& u : next->periodic)
+        {
+                for(const PeriodicUpdate& d : periodic_updates)
+                {
+                        if(d.field_update->target() == u.field_update->target())
+                                u.essential = d.essential;
+                }
+        }
+
+        next->real_time.assign(real_time_updates.begin(), real_time_updates.end());
+        for(const HotkeySpec& hotkey : spec.hotkeys)
+        {
+                if(hotkey.id >= next->real_time.size())
+                        next->real_time.resize(hotkey.id + 1, { nullptr, RealTimeUpdate::Interactive });
+
+                /* a field target runs whatever this config refreshes the field with, nothing when it is off */
+                const FieldUpdate* target = hotkey.field >= 0 ? next->updaters[hotkey.field] : hotkey.field_update;
+                next->real_time[hotkey.id] = { target, hotkey.priority };
+        }
+
+        next->status_fmt = spec.status_fmt;
+        next->layout = spec.status_fmt.empty() ? STATUS_LAYOUT : layout_from_format(next->status_fmt);
+
+        if(spec.pages.empty())
+                next->pages.assign(pages.begin(), pages.end());
+
+        for(const PageSpec& page : spec.pages)
+                next->pages.push_back({ next->strings.emplace_back(page.name), page.fields });
+
+        if(spec.thresholds.empty() && STATUS2D_COLORS)
+                next->thresholds.assign(threshold_rules.begin(), threshold_rules.end());
+
+        for(const ThresholdSpec& t : spec.thresholds)
+                next->thresholds.push_back({ t.field, t.op, t.value, next->strings.emplace_back(t.color) });
+
+        if(spec.sparklines.empty())
+                next->sparklines.assign(sparklines.begin(), sparklines.end());
+
+        for(const SparklineSpec& sparkline : spec.sparklines)
+                next->sparklines.push_back({ sparkline.field, sparkline.min, sparkline.max });
+
+        if(spec.windows.empty())
+                next->windows.assign(aggregate_windows.begin(), aggregate_windows.end());
+
+        for(const WindowSpec& window : spec.windows)
+                next->windows.push_back({ window.field, window.window_ms });
+
+        next->page_interval_ms = spec.page_interval_ms;
+        next->width_budget_px = spec.width_budget_px;
+
+        return next;
+}
+
+bool
+read_config(std::unique_ptr<Config>* next)
+{
+        /* no config file means the compile-time config */
+        *next = nullptr;
+        if(config_path[0] == '\0' || access(config_path, F_OK) < 0)
+                return true;
+
+        ConfigSpec spec;
+        if(!parse_config(config_path, &spec))
+                return false;
+
+        *next = build_config(spec);
+        return true;
+}
+
+bool
+same_update(const FieldUpdate* a, const FieldUpdate* b)
+{
+        if(a == b)
+                return true;
+
+        if(a == nullptr || b == nullptr || a->type != b->type)
+                return false;
+
+        switch(a->type)
+        {
+        case FieldUpdate::Type::Shell:
+                return strcmp(a->args.shell.command, b->args.shell.command) == 0;
+        case FieldUpdate::Type::File:
+                return strcmp(a->args.file.path, b->args.file.path) == 0 && a->args.file.parse == b->args.file.parse;
+        case FieldUpdate::Type::Expr:
+        {
+                /* each reload compiles its own copy, equal ops evaluate to the same text */
+                const ExprProgram& pa = *a->args.expr.program;
+                const ExprProgram& pb = *b->args.expr.program;
+                const auto same_op = [](const ExprProgram::Op& x, const ExprProgram::Op& y) {
+                        return x.code == y.code && x.field == y.field && x.aggregate == y.aggregate && x.constant == y.constant;
+                };
+
+                return pa.precision == pb.precision && pa.op_count == pb.op_count &&
+                       std::equal(pa.ops.begin(), pa.ops.begin() + pa.op_count, pb.ops.begin(), same_op);
+        }
+        default:
+                return false;
+        }
+}
+
+void
+install_config(std::unique_ptr<Config> next)
+{
+        config = std::move(next);
+
+        if(config == nullptr)
+        {
+                field_updaters = default_updaters;
+                active_periodic = periodic_updates;
+                active_real_time = real_time_updates;
+                active_layout = &STATUS_LAYOUT;
+                active_pages = pages;
+                page_interval_ms = PAGE_ROTATE_MS;
+                width_budget_px = STATUS_WIDTH_PX;
+                active_thresholds = STATUS2D_COLORS ? std::span<const ThresholdRule>(threshold_rules) :
+                                                      std::span<const ThresholdRule>();
+                active_sparklines = sparklines;
+                active_windows = aggregate_windows;
+        }
+        else
+        {
+                field_updaters = config->updaters;
+                active_periodic = config->periodic;
+                active_real_time = config->real_time;
+                active_layout = &config->layout;
+                active_pages = config->pages;
+                page_interval_ms = config->page_interval_ms;
+                width_budget_px = config->width_budget_px;
+                active_thresholds = config->thresholds;
+                active_sparklines = config->sparklines;
+                active_windows = config->windows;
+        }
+
+        reset_samples();
+        derived_inputs = dependency_mask(field_updaters);
+
+        /* the rules may have changed under unchanged fields */
+        style_escapes = make_style_escapes(active_thresholds);
+        for(int f = 0; f < R_SIZE; ++f)
+                restyle_field(f);
+
+        /* the caller recomputes visibility once the schedule is in place */
+        current_page = 0;
+        page_deadline_ms = page_interval_ms > 0 ? monotonic_ms() + page_interval_ms : UINT64_MAX;
+}
+
+void
+apply_config(std::unique_ptr<Config> next)
+{
+        /* the old tables stay alive until the schedule has been carried over */
+        const std::unique_ptr<Config> old_config = std::move(config);
+        const std::array<const FieldUpdate*, R_SIZE> old_updaters = field_updaters;
+        const std::span<const PeriodicUpdate> old_periodic = active_periodic;
+        const std::vector<PeriodicState> old_states = std::move(periodic_states);
+
+        install_config(std::move(next));
+
+        /* queued ids index the old hotkey table, which may have shrunk or gained gaps */
+        const std::size_t dropped = interactive_queue.count + background_queue.count;
+        interactive_queue = {};
+        background_queue = {};
+        if(dropped > 0)
+                fmt::print(stderr, "apply_config(): Dropped {} requests queued before the reload\n", dropped);
+
+        std::array<bool, R_SIZE> changed_fields;
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+                changed_fields[f] = !same_update(old_updaters[f], field_updaters[f]);
+
+        /* unchanged fields keep their place in the schedule, only the bounds are re-applied */
+        const std::uint64_t now = monotonic_ms();
+
+        periodic_states.assign(active_periodic.size(), {});
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                const PeriodicUpdate& u = active_periodic[i];
+                PeriodicState& state = periodic_states[i];
+
+                state.interval_ms = u.min_interval_ms;
+                state.deadline_ms = align_to_tick(now, std::uint64_t(state.interval_ms) * interval_multiplier(u));
+
+                if(plugin_owns(u.field_update))
+                {
+                        state.deadline_ms = UINT64_MAX;
+                        continue;
+                }
+
+                if(changed_fields[u.field_update->target() - field_buffers.data()])
+                        continue;
+
+                for(std::size_t j = 0; j < old_periodic.size(); ++j)
+                {
+                        if(old_periodic[j].field_update->target() != u.field_update->target())
+                                continue;
+
+                        state = old_states[j];
+                        state.interval_ms = std::clamp(state.interval_ms, u.min_interval_ms, u.max_interval_ms);
+                }
+        }
+
+        /* only fields whose updater changed are re-run */
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                if(!changed_fields[f])
+                        continue;
+
+                if(file_fds[f] >= 0)
+                {
+                        close(file_fds[f]);
+                        file_fds[f] = -1;
+                }
+
+                if(field_updaters[f] == nullptr)
+                {
+                        field_buffers[f] = {};
+                        field_changed(f);
+                        continue;
+                }
+
+                /* pooled builtins and coroutines reschedule themselves when they finish */
+                const FieldUpdate* u = field_updaters[f];
+                const bool changed = refresh_field(u);
+                if(u->type == FieldUpdate::Type::Shell || u->type == FieldUpdate::Type::File)
+                        reschedule_field(u, changed, monotonic_ms());
+        }
+
+        update_visibility(true);
+        update_screen();
+}
+
+void
+init_config()
+{
+        const char* home = getenv("HOME");
+        if(home == nullptr)
+                return;
+
+        char dir_path[PATH_MAX];
+        const auto dir_res = fmt::format_to_n(dir_path, sizeof(dir_path) - 1, "{}/{}", home, CONFIG_DIR);
+        *dir_res.out = '\0';
+
+        const auto res = fmt::format_to_n(config_path, sizeof(config_path) - 1, "{}/{}", dir_path, CONFIG_NAME);
+        *res.out = '\0';
+
+        std::unique_ptr<Config> next;
+        if(read_config(&next))
+                install_config(std::move(next));
+
+        /* editors usually replace the file, so watch the directory */
+        const int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        die(ifd < 0, "inotify_init1");
+
+        const int wd = inotify_add_watch(ifd, dir_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+        if(wd < 0)
+        {
+                close(ifd);
+                return;
+        }
+
+        pollfds[P_CONFIG].fd = ifd;
+        pollfds[P_CONFIG].events = POLLIN;
+}
+
+void
+handle_config_events()
+{
+        alignas(struct inotify_event) char buf[4096];
+        bool reload = false;
+
+        ssize_t len;
+        while((len = read(pollfds[P_CONFIG].fd, buf, sizeof(buf))) > 0)
+        {
+                for(ssize_t off = 0; off < len;)
+                {
+                        const auto* ev = (const struct inotify_event*)(buf + off);
+                        if(ev->len > 0 && strcmp(ev->name, CONFIG_NAME) == 0)
+                                reload = true;
+
+                        off += sizeof(struct inotify_event) + ev->len;
+                }
+        }
+
+        if(!reload)
+                return;
+
+        /* a broken config leaves the running one in place */
+        std::unique_ptr<Config> next;
+        if(!read_config(&next))
+                return;
+
+        apply_config(std::move(next));
+}
+
+void
+print_stats()
+{
+        const std::uint64_t uptime_ms = monotonic_ms() - stats.start_ms;
+        const double minutes = std::max<double>(uptime_ms, 1) / 60000.0;
+
+        fmt::print(
+            stderr,
+            "stats: uptime {}s, {} wakeups ({:.1f}/min), power: {}\n",
+            uptime_ms / 1000,
+            stats.wakeups,
+            stats.wakeups / minutes,
+            on_battery ? "battery" : "ac"
+        );
+
+        /* p99 over the most recent interactive requests */
+        const std::size_t n = std::min(stats.interactive_count, std::uint64_t(LATENCY_SAMPLES));
+        std::array<std::uint32_t, LATENCY_SAMPLES> sorted = stats.interactive_latency_us;
+        std::uint32_t p99 = 0;
+        if(n > 0)
+        {
+                const std::size_t k = std::min(n - 1, n * 99 / 100);
+                std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + n);
+                p99 = sorted[k];
+        }
+
+        fmt::print(
+            stderr,
+            "stats: interactive p99 {}us over {} requests (SLO {}us: {}), background deferred {} times\n",
+            p99,
+            n,
+            INTERACTIVE_SLO_US,
+            p99 <= INTERACTIVE_SLO_US ? "met" : "violated",
+            stats.budget_exhausted
+        );
+
+        fmt::print(
+            stderr,
+            "stats: {} file reads in {} syscalls ({})\n",
+            stats.file_reads,
+            stats.read_syscalls,
+#ifndef NO_IO_URING
+            uring.fd >= 0 ? "io_uring" : "pread"
+#else
+            "pread"
+#endif
+        );
+
+        for(std::size_t i = 0; i < plugin_count; ++i)
+        {
+                const Plugin& plugin = plugins[i];
+                fmt::print(
+                    stderr,
+                    "stats: plugin {} ({}): {} updates, avg {}us, max {}us\n",
+                    plugin.desc->name != nullptr ? plugin.desc->name : "?",
+                    field_names[plugin.field],
+                    plugin.updates,
+                    plugin.updates > 0 ? plugin.total_us / plugin.updates : 0,
+                    plugin.max_us
+                );
+        }
+
+        for(std::size_t i = 0; i < active_sparklines.size(); ++i)
+        {
+                /* the ring oldest first, as drawn */
+                const SparklineHistory& h = sparkline_history;
+                const std::size_t oldest = (h.head[i] + SPARKLINE_SAMPLES - h.count[i]) % SPARKLINE_SAMPLES;
+
+                char levels[SPARKLINE_SAMPLES + 1] = {};
+                for(std::size_t k = 0; k < h.count[i]; ++k)
+                        levels[k] = char('0' + h.levels[i][(oldest + k) % SPARKLINE_SAMPLES]);
+
+                fmt::print(stderr, "stats: sparkline ({}): {} samples, levels {}\n", field_names[active_sparklines[i].field], h.count[i], levels);
+        }
+
+        for(std::size_t i = 0; i < active_windows.size(); ++i)
+        {
+                double values[AggregateWindow::AggregateSize] = {};
+                for(int a = 0; a < AggregateWindow::AggregateSize; ++a)
+                        window_aggregate(i, a, &values[a]);
+
+                fmt::print(
+                    stderr,
+                    "stats: window[{}] ({}, {}ms): {} samples, min {}, max {}, avg {:.2f}, rate {:.4f}/s\n",
+                    i,
+                    field_names[active_windows[i].field],
+                    active_windows[i].window_ms,
+                    window_states[i].next_seq - window_states[i].first_seq,
+                    values[AggregateWindow::Min],
+                    values[AggregateWindow::Max],
+                    values[AggregateWindow::Avg],
+                    values[AggregateWindow::Rate]
+                );
+        }
+
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                fmt::print(
+                    stderr,
+                    "stats: periodic[{}] ({}): interval {}ms, unchanged for {} refreshes\n",
+                    i,
+                    field_names[active_periodic[i].field_update->target() - field_buffers.data()],
+                    periodic_states[i].interval_ms,
+                    periodic_states[i].unchanged_count
+                );
+        }
+}
+
+int
+run_due_updates(const std::uint64_t budget_end_ms)
+{
+        std::uint64_t now = monotonic_ms();
+        bool changed_any = false;
+
+        update_power_state(now);
+
+        if(detect_resume())
+        {
+                refresh_now(resume_fields);
+                clock_changed = false;
+        }
+        else if(clock_changed)
+        {
+                refresh_now(clock_change_fields);
+                clock_changed = false;
+        }
+
+        if(update_blank_state() && !screen_blanked)
+        {
+                catch_up_after_blank();
+                now = monotonic_ms();
+        }
+
+        /* due procfs/sysfs reads are batched into a single submission */
+        std::array<const FieldUpdate*, R_SIZE> file_group;
+        std::array<std::size_t, R_SIZE> file_group_idx;
+        std::size_t file_group_size = 0;
+
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                if(periodic_states[i].deadline_ms > now || active_periodic[i].field_update->type != FieldUpdate::Type::File)
+                        continue;
+
+                if(plugin_owns(active_periodic[i].field_update) || !field_visible(active_periodic[i].field_update))
+                        continue;
+
+                if(screen_blanked && !active_periodic[i].essential)
+                        continue;
+
+                file_group[file_group_size] = active_periodic[i].field_update;
+                file_group_idx[file_group_size] = i;
+                ++file_group_size;
+        }
+
+        if(file_group_size > 0)
+        {
+                std::array<bool, R_SIZE> changed;
+                refresh_files(file_group.data(), file_group_size, changed.data());
+
+                now = monotonic_ms();
+                for(std::size_t k = 0; k < file_group_size; ++k)
+                {
+                        reschedule(file_group_idx[k], changed[k], now);
+                        changed_any = changed_any || changed[k];
+                }
+        }
+
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                if(periodic_states[i].deadline_ms > now)
+                        continue;
+
+                if(screen_blanked && !active_periodic[i].essential)
+                        continue;
+
+                /* hidden fields are not polled, update_visibility() catches them up */
+                if(!field_visible(active_periodic[i].field_update))
+                        continue;
+
+                if(now >= budget_end_ms)
+                {
+                        ++stats.budget_exhausted;
+                        if(changed_any)
+                                update_screen();
+
+                        return 0;
+                }
+
+                const FieldUpdate* u = active_periodic[i].field_update;
+                if(plugin_owns(u))
+                {
+                        periodic_states[i].deadline_ms = UINT64_MAX;
+                        continue;
+                }
+
+                if(u->type == FieldUpdate::Type::Builtin)
+                {
+                        /* parked until the worker result is applied in drain_pool_results() */
+                        pool_submit(u, 0);
+                        periodic_states[i].deadline_ms = UINT64_MAX;
+                        continue;
+                }
+
+                if(u->type == FieldUpdate::Type::Coroutine)
+                {
+                        /* parked until finish_coroutine(), which may already happen inside start_coroutine() */
+                        periodic_states[i].deadline_ms = UINT64_MAX;
+                        start_coroutine(u, 0);
+                        continue;
+                }
+
+                const bool changed = refresh_field(u);
+                changed_any = changed_any || changed;
+
+                now = monotonic_ms();
+                reschedule(i, changed, now);
+
+                service_interactive();
+        }
+
+        if(changed_any)
+                update_screen();
+
+        /* time until the next deadline, used as the poll() timeout */
+        std::uint64_t next = UINT64_MAX;
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                if((!screen_blanked || active_periodic[i].essential) && field_visible(active_periodic[i].field_update))
+                        next = std::min(next, periodic_states[i].deadline_ms);
+        }
+
+        if(screen_blanked)
+                next = std::min(next, now + BLANK_CHECK_MS);
+
+        if(next == UINT64_MAX)
+                return -1;
+
+        return next > now ? int(next - now) : 0;
+}
+
+bool
+crossed_midnight(const FieldBuffer*, const FieldBuffer*)
+{
+        /* compare local days rather than "HH:MM:SS" strings, which miss a day change
+           when the time field was stale for over a day (e.g. while the screen was blanked) */
+        static int last_day = -1;
+
+        const time_t t = time(nullptr);
+        struct tm tm;
+        if(localtime_r(&t, &tm) == nullptr)
+                return false;
+
+        const int day = tm.tm_year * 366 + tm.tm_yday;
+        const bool crossed = last_day >= 0 && day != last_day;
+        last_day = day;
+
+        return crossed;
+}
+
+bool
+queue_push(RequestQueue* queue, const PendingRequest& req)
+{
+        if(queue->count == queue->items.size())
+                return false;
+
+        queue->items[(queue->head + queue->count) % queue->items.size()] = req;
+        ++queue->count;
+
+        return true;
+}
+
+bool
+queue_pop(RequestQueue* queue, PendingRequest* req)
+{
+        if(queue->count == 0)
+                return false;
+
+        *req = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->items.size();
+        --queue->count;
+
+        return true;
+}
+
+void
+service_interactive()
+{
+        /* picks up requests that arrived while background work was running */
+        drain_socket();
+
+        PendingRequest req;
+        while(running && queue_pop(&interactive_queue, &req))
+        {
+                const FieldUpdate* u = active_updater(active_real_time[req.id].field_update);
+                if(u == nullptr || plugin_owns(u))
+                        continue;
+
+                if(u->type == FieldUpdate::Type::Builtin)
+                {
+                        /* drawn and timed when the worker result comes back */
+                        pool_submit(u, req.received_us);
+                        continue;
+                }
+
+                if(u->type == FieldUpdate::Type::Coroutine)
+                {
+                        start_coroutine(u, req.received_us);
+                        continue;
+                }
+
+                refresh_field(u);
+                update_screen();
+                record_interactive_latency(req.received_us);
+        }
+}
+
+bool
+run_background(const std::uint64_t budget_end_ms)
+{
+        bool ran = false;
+
+        PendingRequest req;
+        while(running && monotonic_ms() < budget_end_ms && queue_pop(&background_queue, &req))
+        {
+                refresh_field(active_real_time[req.id].field_update);
+                ran = true;
+
+                service_interactive();
+        }
+
+        if(ran)
+                update_screen();
+
+        if(background_queue.count > 0)
+        {
+                ++stats.budget_exhausted;
+                return false;
+        }
+
+        return true;
+}
+
+int
+run_scheduler()
+{
+        service_interactive();
+
+        /* background requests and periodic refreshes get one budget each per iteration,
+           so a held hotkey keeping the background queue full cannot starve due fields */
+        const bool background_done = run_background(monotonic_ms() + BACKGROUND_BUDGET_MS);
+
+        std::uint64_t now = monotonic_ms();
+        if(now >= page_deadline_ms)
+                next_page();
+
+        if(now >= psi_deadline_ms)
+                recheck_psi();
+
+        const int timeout = run_due_updates(monotonic_ms() + BACKGROUND_BUDGET_MS);
+        const int plugin_timeout = run_due_plugins();
+
+        /* come straight back for the rest of the queue */
+        if(!background_done)
+                return 0;
+
+        now = monotonic_ms();
+        const int page_timeout = page_deadline_ms == UINT64_MAX ? -1 : page_deadline_ms > now ? int(page_deadline_ms - now) : 0;
+        const int psi_timeout = psi_deadline_ms == UINT64_MAX ? -1 : psi_deadline_ms > now ? int(psi_deadline_ms - now) : 0;
+
+        int earliest = -1;
+        for(const int t : { timeout, plugin_timeout, page_timeout, psi_timeout })
+        {
+                if(t >= 0)
+                        earliest = earliest < 0 ? t : std::min(earliest, t);
+        }
+
+        return earliest;
+}
+
+void
+refresh_polled()
+{
+        refresh_fields<R_TIME, R_MEM, R_TEMP, R_LOAD, R_BAT>();
+}
+
+void
+next_page()
+{
+        if(active_pages.size() > 1)
+        {
+                current_page = (current_page + 1) % active_pages.size();
+                update_visibility(false);
+                update_screen();
+        }
+
+        page_deadline_ms = page_interval_ms > 0 ? monotonic_ms() + page_interval_ms : UINT64_MAX;
+}
+
+bool
+field_visible(const FieldUpdate* field_update)
+{
+        const FieldBuffer* field_buffer = field_update->target();
+
+        return field_buffer == nullptr || (visible_fields & (1u << (field_buffer - field_buffers.data())));
+}
+
+void
+update_visibility(const bool force)
+{
+        std::uint32_t shown = active_pages.empty() ? ALL_FIELDS : active_pages[current_page].fields;
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                /* a field nothing updates takes no room */
+                if(!active_layout->fields[f].visible || (field_updaters[f] == nullptr && !plugin_fields[f]))
+                        shown &= ~(1u << f);
+        }
+
+        if(shown == visible_fields && !force)
+                return;
+
+        const std::uint32_t appeared = shown & ~visible_fields;
+        visible_fields = shown;
+        render_plan = make_render_plan(*active_layout, shown);
+
+        /* widths depend on the caps and literals of the plan */
+        dirty_widths = ALL_FIELDS;
+#ifndef NO_XFT
+        literal_width_dirty = true;
+#endif
+
+        /* hidden fields were not polled, bring the ones coming into view up to date */
+        const std::uint64_t now = monotonic_ms();
+        std::uint32_t periodic = 0;
+        for(std::size_t i = 0; i < periodic_states.size(); ++i)
+        {
+                const std::uint32_t bit = 1u << (active_periodic[i].field_update->target() - field_buffers.data());
+                periodic |= bit;
+                if((appeared & bit) && periodic_states[i].deadline_ms != UINT64_MAX)
+                        periodic_states[i].deadline_ms = now;
+        }
+
+        for(std::size_t i = 0; i < plugin_count; ++i)
+        {
+                if((appeared & (1u << plugins[i].field)) && plugins[i].desc->interval_ms > 0)
+                        plugins[i].deadline_ms = now;
+        }
+
+        /* before the scheduler runs there is nothing to catch up on */
+        if(periodic_states.empty())
+                return;
+
+        /* toggles are never re-run, they only change on request */
+        for(std::size_t f = 0; f < R_SIZE; ++f)
+        {
+                const FieldUpdate* u = field_updaters[f];
+                if(!(appeared & (1u << f)) || (periodic & (1u << f)) || u == nullptr)
+                        continue;
+
+                if(u->type == FieldUpdate::Type::Shell || u->type == FieldUpdate::Type::File)
+                        refresh_field(u);
+        }
+
+        /* a polled net is already due above, otherwise the links it missed while hidden are shown now */
+        if((appeared & (1u << R_NET)) && std::exchange(net_links_stale, false) &&
+           !(periodic & (1u << R_NET)) && field_updaters[R_NET] != nullptr)
+                refresh_field(field_updaters[R_NET]);
+}
+
+void
+toggle_lang(FieldBuffer* field_buffer)
+{
+        static constexpr std::string_view ltable[2] = {
+            {"US"},
+            {"RO"}
+        };
+
+        static constexpr const char* commands[2] = {
+            "setxkbmap us; setxkbmap -option numpad:mac",
+            "setxkbmap ro -variant std"
+        };
+
+        static std::size_t idx = 1;
+
+        idx = !idx;
+        std::system(commands[idx]);
+
+        memcpy(field_buffer->data, ltable[idx].data(), 2);
+        field_buffer->length = 2;
+}
+
+void
+toggle_cpu_gov(FieldBuffer* field_buffer)
+{
+        static constexpr std::string_view freq_table[2] = {
+            {"*"},
+            {"$"}
+        };
+
+        static constexpr const char* commands[2] = {
+            "xss-set-save",
+            "xss-set-perf"
+        };
+
+        static std::size_t idx = 1;
+
+        idx = !idx;
+        std::system(commands[idx]);
+
+        memcpy(field_buffer->data, freq_table[idx].data(), 1);
+        field_buffer->length = 1;
+}
+
+void
+toggle_mic(FieldBuffer* field_buffer)
+{
+        static constexpr std::string_view mic_status_table[2] = {
+            {"0"},
+            {"1"}
+        };
+
+        static constexpr const char* command = "pactl set-source-mute @DEFAULT_SOURCE@ toggle";
+
+        static std::size_t idx = 1;
+
+        idx = !idx;
+        std::system(command);
+
+        memcpy(field_buffer->data, mic_status_table[idx].data(), 1);
+        field_buffer->length = 1;
+}
+
+void
+read_cpu(FieldBuffer* field_buffer)
+{
+        /* runs on a pool worker, one job at a time */
+        static int fd = -1;
+        static CpuTimes prev;
+        static CpuTimes cur;
+        static char text[PROC_STAT_READ_SIZE];
+        static std::array<std::uint8_t, MAX_CPUS + 1> busy_pct;
+        static bool have_prev = false;
+
+        field_buffer->length = 0;
+        field_buffer->data[0] = '\0';
+
+        if(fd < 0 && (fd = open(PROC_STAT_PATH, O_RDONLY | O_CLOEXEC)) < 0)
+                return;
+
+        /* the kernel renders the whole file again for every read from offset 0 */
+        const ssize_t n = pread(fd, text, sizeof(text), 0);
+        if(n <= 0)
+                return;
+
+        const std::size_t rows = parse_proc_stat(text, text + n, &cur);
+        if(rows == 0)
+                return;
+
+        /* the first sample is the average since boot, it only primes prev */
+        const bool primed = std::exchange(have_prev, true);
+        if(primed)
+                cpu_busy_percent(prev, cur, rows, busy_pct.data());
+
+        prev = cur;
+        if(!primed)
+                return;
+
+        const std::uint8_t hottest = rows > 1 ? *std::max_element(busy_pct.begin() + 1, busy_pct.begin() + rows) : busy_pct[0];
+        const auto res = fmt::format_to_n(field_buffer->data, BUFFER_MAX_SIZE, "{}% max {}%", busy_pct[0], hottest);
+        field_buffer->length = res.out - field_buffer->data;
+        field_buffer->data[field_buffer->length] = '\0';
+}
+
+void
+read_net(FieldBuffer* field_buffer)
+{
+        /* runs on a pool worker, one job at a time */
+        static int fd = -1;
+        static char text[NET_DEV_READ_SIZE];
+        static NetLinks shown;
+        static NetCounters prev;
+        static std::uint64_t prev_ms = 0;
+        static std::uint32_t generation = UINT32_MAX;
+
+        field_buffer->length = 0;
+        field_buffer->data[0] = '\0';
+
+        /* the interface set is only looked at again after a link event */
+        const std::uint32_t current = net_links_generation.load(std::memory_order_acquire);
+        if(current != generation)
+        {
+                NetLinks next;
+                {
+                        const std::lock_guard<std::mutex> guard(net_links_lock);
+                        next = net_links;
+                }
+
+                NetCounters carried;
+                for(std::size_t i = 0; i < next.count; ++i)
+                {
+                        for(std::size_t j = 0; j < shown.count; ++j)
+                        {
+                                if(next.names[i] != shown.names[j] || !(prev.valid & (1u << j)))
+                                        continue;
+
+                                carried.rx[i] = prev.rx[j];
+                                carried.tx[i] = prev.tx[j];
+                                carried.valid |= 1u << i;
+                        }
+                }
+
+                shown = next;
+                prev = carried;
+                generation = current;
+        }
+
+        if(shown.count == 0)
+                return;
+
+        if(fd < 0 && (fd = open(NET_DEV_PATH, O_RDONLY | O_CLOEXEC)) < 0)
+                return;
+
+        const ssize_t n = pread(fd, text, sizeof(text), 0);
+        const std::uint64_t now = monotonic_ms();
+        if(n <= 0)
+                return;
+
+        /* "  name: rx_bytes packets errs drop fifo frame compressed multicast tx_bytes ...", two header lines */
+        NetCounters cur;
+        const char* end = text + n;
+        const char* p = text;
+        for(int skip = 0; skip < 2 && p != nullptr; ++skip)
+        {
+                p = (const char*)memchr(p, '\n', end - p);
+                p = p != nullptr ? p + 1 : nullptr;
+        }
+
+        while(p != nullptr && p < end)
+        {
+                while(p < end && *p == ' ')
+                        ++p;
+
+                const char* colon = (const char*)memchr(p, ':', end - p);
+                const char* eol = (const char*)memchr(p, '\n', end - p);
+                if(colon == nullptr || eol == nullptr || colon > eol)
+                        break;
+
+                /* lines of links that are not shown are skipped without parsing the counters */
+                const std::string_view name(p, colon - p);
+                for(std::size_t i = 0; i < shown.count; ++i)
+                {
+                        if(name != shown.names[i].data())
+                                continue;
+
+                        const char* q = colon + 1;
+                        cur.rx[i] = scan_u64(&q, eol);
+                        for(int k = 0; k < 7; ++k)
+                                scan_u64(&q, eol);
+                        cur.tx[i] = scan_u64(&q, eol);
+                        cur.valid |= 1u << i;
+                }
+
+                p = eol + 1;
+        }
+
+        char* out = field_buffer->data;
+        const std::uint64_t elapsed_ms = std::max<std::uint64_t>(now - prev_ms, 1);
+        for(std::size_t i = 0; i < shown.count; ++i)
+        {
+                if(!(cur.valid & prev.valid & (1u << i)) || out + IFNAMSIZ + 32 > field_buffer->data + BUFFER_MAX_SIZE)
+                        continue;
+
+                /* counters only go back when a link is recreated under the same name */
+                const std::uint64_t rx = cur.rx[i] >= prev.rx[i] ? (cur.rx[i] - prev.rx[i]) * 1000 / elapsed_ms : 0;
+                const std::uint64_t tx = cur.tx[i] >= prev.tx[i] ? (cur.tx[i] - prev.tx[i]) * 1000 / elapsed_ms : 0;
+
+                if(out != field_buffer->data)
+                        *out++ = ' ';
+
+                const std::size_t name_len = strlen(shown.names[i].data());
+                memcpy(out, shown.names[i].data(), name_len);
+                out += name_len;
+                memcpy(out, " \u2193", 4);
+                out += 4;
+                out += format_bytes(out, rx);
+                memcpy(out, " \u2191", 4);
+                out += 4;
+                out += format_bytes(out, tx);
+        }
+
+        prev = cur;
+        prev_ms = now;
+
+        field_buffer->length = out - field_buffer->data;
+        *out = '\0';
+}
+
+void
+read_psi(FieldBuffer* field_buffer)
 {
-        switch(field_update->type)
+        /* runs on a pool worker, with fds of its own next to the trigger fds of the main thread */
+        static constexpr char labels[] = "cmi";
+        static std::array<int, PSI_PATHS.size()> fds = { -1, -1, -1 };
+
+        char* out = field_buffer->data;
+        for(std::size_t i = 0; i < PSI_PATHS.size(); ++i)
         {
-        case FieldUpdate::Type::Shell:
+                if(fds[i] < 0 && (fds[i] = open(PSI_PATHS[i], O_RDONLY | O_CLOEXEC)) < 0)
+                        continue;
+
+                /* "some avg10=1.23 avg60=...", the avg10 text is copied as is */
+                char text[256];
+                const ssize_t n = pread(fds[i], text, sizeof(text) - 1, 0);
+                if(n <= 0)
+                        continue;
+
+                text[n] = '\0';
+                const char* avg10 = strstr(text, "avg10=");
+                if(avg10 == nullptr)
+                        continue;
+
+                avg10 += 6;
+                const std::size_t len = strcspn(avg10, " \n");
+
+                if(out != field_buffer->data)
+                        *out++ = ' ';
+                *out++ = labels[i];
+                memcpy(out, avg10, len);
+                out += len;
+        }
+
+        field_buffer->length = out - field_buffer->data;
+        *out = '\0';
+}
+
+void
+read_disk(FieldBuffer* field_buffer)
+{
+        char* out = field_buffer->data;
+        for(std::string_view rest = DISK_MOUNTS; !rest.empty();)
         {
-                auto& args = field_update->args.shell;
-                const int rc = read_cmd_output(args.command, args.field_buffer);
-                die(rc < 0, "read_cmd_output");
+                const std::size_t end = std::min(rest.find(' '), rest.size());
+                const std::string mount(rest.substr(0, end));
+                rest.remove_prefix(std::min(end + 1, rest.size()));
+
+                struct statvfs st;
+                if(mount.empty() || statvfs(mount.c_str(), &st) < 0 || out + mount.size() + 8 > field_buffer->data + BUFFER_MAX_SIZE)
+                        continue;
+
+                /* space an unprivileged user can still use */
+                if(out != field_buffer->data)
+                        *out++ = ' ';
+                memcpy(out, mount.data(), mount.size());
+                out += mount.size();
+                *out++ = ' ';
+                out += format_bytes(out, std::uint64_t(st.f_bavail) * st.f_frsize);
+        }
+
+        field_buffer->length = out - field_buffer->data;
+        *out = '\0';
+}
+
+void
+read_dio(FieldBuffer* field_buffer)
+{
+        /* runs on a pool worker, one job at a time */
+        static int fd = -1;
+        static char text[DISKSTATS_READ_SIZE];
+        static std::array<std::array<char, 32>, MAX_BLOCK_DEVICES> names = {};
+        static DiskCounters prev;
+        static std::uint64_t prev_ms = 0;
+        static bool reported = false;
+
+        field_buffer->length = 0;
+        field_buffer->data[0] = '\0';
+
+        const BlockDevices& d = block_devices;
+        if(d.count == 0 || (fd < 0 && (fd = open(DISKSTATS_PATH, O_RDONLY | O_CLOEXEC)) < 0))
+                return;
+
+        const ssize_t n = pread(fd, text, sizeof(text), 0);
+        const std::uint64_t now = monotonic_ms();
+        if(n <= 0)
+                return;
+
+        /* "major minor name reads merged sectors_read ms writes merged sectors_written ...",
+           the numbers in front pick the line, every other line is skipped to its newline */
+        DiskCounters cur;
+        const char* end = text + n;
+        for(const char* p = text; p < end;)
+        {
+                const char* eol = (const char*)memchr(p, '\n', end - p);
+                if(eol == nullptr)
+                        break;
+
+                const auto major_id = unsigned(scan_u64(&p, eol));
+                const auto minor_id = unsigned(scan_u64(&p, eol));
+
+                for(std::size_t i = 0; i < d.count; ++i)
+                {
+                        if(d.major[i] != major_id || d.minor[i] != minor_id)
+                                continue;
+
+                        while(p < eol && *p == ' ')
+                                ++p;
+                        const char* name = p;
+                        while(p < eol && *p != ' ')
+                                ++p;
+                        if(names[i][0] == '\0')
+                                memcpy(names[i].data(), name, std::min<std::size_t>(p - name, names[i].size() - 1));
+
+                        scan_u64(&p, eol);
+                        scan_u64(&p, eol);
+                        cur.read[i] = scan_u64(&p, eol);
+                        scan_u64(&p, eol);
+                        scan_u64(&p, eol);
+                        scan_u64(&p, eol);
+                        cur.written[i] = scan_u64(&p, eol);
+                        cur.valid |= 1u << i;
+                }
+
+                p = eol + 1;
+        }
+
+        if(cur.valid == 0 && !std::exchange(reported, true))
+                fmt::print(stderr, "read_dio(): none of the {} devices is listed in {}\n", d.count, DISKSTATS_PATH);
+
+        /* diskstats counts 512-byte sectors whatever the device's sector size */
+        char* out = field_buffer->data;
+        const std::uint64_t elapsed_ms = std::max<std::uint64_t>(now - prev_ms, 1);
+        for(std::size_t i = 0; i < d.count; ++i)
+        {
+                if(!(cur.valid & prev.valid & (1u << i)) || out + 64 > field_buffer->data + BUFFER_MAX_SIZE)
+                        continue;
+
+                /* a device that was removed and re-added starts counting from zero again */
+                const std::uint64_t read = cur.read[i] >= prev.read[i] ? (cur.read[i] - prev.read[i]) * 512 * 1000 / elapsed_ms : 0;
+                const std::uint64_t written = cur.written[i] >= prev.written[i] ? (cur.written[i] - prev.written[i]) * 512 * 1000 / elapsed_ms : 0;
+
+                if(out != field_buffer->data)
+                        *out++ = ' ';
+
+                const std::size_t name_len = strlen(names[i].data());
+                memcpy(out, names[i].data(), name_len);
+                out += name_len;
+                memcpy(out, " r", 2);
+                out += 2;
+                out += format_bytes(out, read);
+                memcpy(out, " w", 2);
+                out += 2;
+                out += format_bytes(out, written);
+        }
+
+        prev = cur;
+        prev_ms = now;
+
+        field_buffer->length = out - field_buffer->data;
+        *out = '\0';
+}
+
+void
+read_top(FieldBuffer* field_buffer)
+{
+        /* runs on a pool worker, one job at a time */
+        static int proc_fd = -1;
+        alignas(struct dirent64) static char dents[GETDENTS_BUFFER_SIZE];
+        static std::size_t dents_pos = 0;
+        static std::size_t dents_len = 0;
+        static ProcSamples tables[2];
+        static ProcSamples* samples = &tables[0];
+        static std::uint32_t cycle = 1;
+        static const long ticks_per_s = sysconf(_SC_CLK_TCK);
+
+        /* the busiest process of the cycle in progress, and of the last finished one */
+        static std::uint64_t best_permille = 0;
+        static std::array<char, 16> best_comm = {};
+        static char shown[BUFFER_MAX_SIZE + 1];
+        static std::size_t shown_length = 0;
+
+        if(proc_fd < 0 && (proc_fd = open(PROC_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        {
+                field_buffer->length = 0;
+                field_buffer->data[0] = '\0';
+                return;
+        }
+
+        /* the directory position is kept between refreshes, so a cycle over
+           every pid may take several refreshes but each costs at most the budget */
+        const std::uint64_t now = monotonic_ms();
+        for(std::size_t scanned = 0; scanned < TOP_SCAN_BUDGET;)
+        {
+                if(dents_pos == dents_len)
+                {
+                        const long n = syscall(SYS_getdents64, proc_fd, dents, sizeof(dents));
+                        dents_pos = 0;
+                        dents_len = n > 0 ? std::size_t(n) : 0;
+                }
+
+                if(dents_len == 0)
+                {
+                        /* end of cycle: publish its top and forget the pids that are gone */
+                        if(best_comm[0] != '\0')
+                        {
+                                const auto res = fmt::format_to_n(shown, BUFFER_MAX_SIZE, "{} {}%", best_comm.data(), (best_permille + 5) / 10);
+                                shown_length = res.out - shown;
+                        }
+                        else
+                        {
+                                shown_length = 0;
+                        }
+                        shown[shown_length] = '\0';
+
+                        ProcSamples* spare = samples == &tables[0] ? &tables[1] : &tables[0];
+                        prune_proc_samples(*samples, spare, cycle);
+                        samples = spare;
+
+                        ++cycle;
+                        best_permille = 0;
+                        best_comm[0] = '\0';
+                        lseek(proc_fd, 0, SEEK_SET);
+                        break;
+                }
+
+                const auto* dent = (const struct dirent64*)(dents + dents_pos);
+                dents_pos += dent->d_reclen;
+
+                if(dent->d_type != DT_DIR || unsigned(dent->d_name[0] - '0') >= 10)
+                        continue;
+
+                ++scanned;
+
+                char path[32];
+                const auto name_len = std::min(strlen(dent->d_name), sizeof(path) - sizeof("/stat"));
+                memcpy(path, dent->d_name, name_len);
+                memcpy(path + name_len, "/stat", sizeof("/stat"));
+
+                const int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+                if(fd < 0)
+                        continue;  /* exited since the directory was read */
+
+                char text[512];
+                const ssize_t n = pread(fd, text, sizeof(text), 0);
+                close(fd);
+
+                std::string_view comm;
+                std::uint64_t ticks;
+                if(n <= 0 || !parse_pid_stat(text, text + n, &comm, &ticks))
+                        continue;
+
+                const auto pid = std::int32_t(atoi(dent->d_name));
+                const std::size_t slot = proc_sample_slot(*samples, pid);
+                if(slot == TOP_TABLE_SIZE)
+                        continue;  /* table full, the pid is left out until some exit */
+
+                /* a pid reused since the last cycle shows up as cpu time going backwards */
+                if(samples->pid[slot] == pid && samples->cycle[slot] + 1 == cycle && ticks >= samples->ticks[slot])
+                {
+                        /* per mille of one cpu, like top */
+                        const std::uint64_t elapsed_ms = std::max<std::uint64_t>(now - samples->sampled_ms[slot], 1);
+                        const std::uint64_t permille = (ticks - samples->ticks[slot]) * 1000000 / (std::uint64_t(ticks_per_s) * elapsed_ms);
+                        if(permille > best_permille || best_comm[0] == '\0')
+                        {
+                                best_permille = permille;
+                                const std::size_t len = std::min(comm.size(), best_comm.size() - 1);
+                                memcpy(best_comm.data(), comm.data(), len);
+                                best_comm[len] = '\0';
+                        }
+                }
+                else if(samples->pid[slot] != pid)
+                {
+                        samples->pid[slot] = pid;
+                        ++samples->count;
+                }
+
+                samples->ticks[slot] = ticks;
+                samples->sampled_ms[slot] = now;
+                samples->cycle[slot] = cycle;
+        }
+
+        memcpy(field_buffer->data, shown, shown_length + 1);
+        field_buffer->length = shown_length;
+}
+
+std::size_t
+proc_sample_slot(const ProcSamples& samples, const std::int32_t pid)
+{
+        /* the pid's slot, or a free one to put it in; TOP_TABLE_SIZE when it cannot be added */
+        const std::size_t mask = TOP_TABLE_SIZE - 1;
+        for(std::size_t i = (std::uint32_t(pid) * 2654435761u) & mask;; i = (i + 1) & mask)
+        {
+                if(samples.pid[i] == pid)
+                        return i;
+
+                if(samples.pid[i] == 0)
+                        return samples.count < TOP_MAX_PIDS ? i : TOP_TABLE_SIZE;
+        }
+}
+
+void
+prune_proc_samples(const ProcSamples& from, ProcSamples* to, const std::uint32_t cycle)
+{
+        /* rehashing into a clean table is simpler than deleting under linear probing */
+        to->pid.fill(0);
+        to->count = 0;
+
+        for(std::size_t i = 0; i < TOP_TABLE_SIZE; ++i)
+        {
+                if(from.pid[i] == 0 || from.cycle[i] != cycle)
+                        continue;
+
+                const std::size_t slot = proc_sample_slot(*to, from.pid[i]);
+                to->pid[slot] = from.pid[i];
+                to->ticks[slot] = from.ticks[i];
+                to->sampled_ms[slot] = from.sampled_ms[i];
+                to->cycle[slot] = from.cycle[i];
+                ++to->count;
+        }
+}
+
+bool
+parse_pid_stat(const char* text, const char* end, std::string_view* comm, std::uint64_t* ticks)
+{
+        /* "pid (comm) state ppid ... utime stime ...", comm may hold spaces and parentheses */
+        const char* open_paren = (const char*)memchr(text, '(', end - text);
+        const char* close_paren = (const char*)memrchr(text, ')', end - text);
+        if(open_paren == nullptr || close_paren == nullptr || close_paren < open_paren)
+                return false;
+
+        *comm = std::string_view(open_paren + 1, close_paren - open_paren - 1);
+
+        /* utime is the 12th field after the comm; tpgid may be -1, so count spaces instead of numbers */
+        const char* p = close_paren + 1;
+        for(int spaces = 0; p < end && spaces < 12; ++p)
+        {
+                if(*p == ' ')
+                        ++spaces;
+        }
+
+        if(p == end)
+                return false;
+
+        const std::uint64_t utime = scan_u64(&p, end);
+        const std::uint64_t stime = scan_u64(&p, end);
+        *ticks = utime + stime;
+
+        return true;
+}
+
+std::size_t
+format_bytes(char* out, const std::uint64_t bytes)
+{
+        /* at most four digits and a unit, e.g. "512B", "1.2K", "340K", "12M" */
+        static constexpr char units[] = "BKMGT";
+
+        double value = double(bytes);
+        std::size_t unit = 0;
+        while(value >= 1000 && unit + 1 < sizeof(units) - 1)
+        {
+                value /= 1024;
+                ++unit;
+        }
+
+        const auto res = unit > 0 && value < 10 ? fmt::format_to_n(out, 8, "{:.1f}{}", value, units[unit]) :
+                                                  fmt::format_to_n(out, 8, "{}{}", std::uint64_t(value), units[unit]);
+        return res.out - out;
+}
+
+std::uint64_t
+scan_u64(const char** p, const char* end)
+{
+        const char* s = *p;
+        while(s < end && *s == ' ')
+                ++s;
+
+        std::uint64_t value = 0;
+        for(; s < end && unsigned(*s - '0') < 10; ++s)
+                value = value * 10 + unsigned(*s - '0');
+
+        *p = s;
+        return value;
+}
+
+std::size_t
+parse_proc_stat(const char* p, const char* end, CpuTimes* times)
+{
+        /* the cpu lines come first, scanning stops at the first other line ("intr" is by far the longest) */
+        std::size_t rows = 0;
+        while(end - p > 3 && p[0] == 'c' && p[1] == 'p' && p[2] == 'u')
+        {
+                p += 3;
+                const std::size_t row = *p == ' ' ? 0 : scan_u64(&p, end) + 1;
+
+                /* user nice system idle iowait irq softirq steal, guest time is already in user */
+                std::uint64_t t[8];
+                for(std::uint64_t& v : t)
+                        v = scan_u64(&p, end);
+
+                p = (const char*)memchr(p, '\n', end - p);
+                if(p == nullptr)
+                        break;  /* cut off by the read size */
+                ++p;
+
+                if(row > MAX_CPUS)
+                        continue;
+
+                times->busy[row] = t[0] + t[1] + t[2] + t[5] + t[6] + t[7];
+                times->idle[row] = t[3] + t[4];
+                rows = std::max(rows, row + 1);
+        }
+
+        return rows;
+}
+
+void
+cpu_busy_percent(const CpuTimes& prev, const CpuTimes& cur, const std::size_t rows, std::uint8_t* busy_pct)
+{
+        /* 64-bit deltas, a 32-bit total overflows within weeks on a many-core box */
+        for(std::size_t i = 0; i < rows; ++i)
+        {
+                const auto busy = std::int64_t(cur.busy[i] - prev.busy[i]);
+                const auto total = busy + std::int64_t(cur.idle[i] - prev.idle[i]);
+
+                /* per-cpu iowait may go backwards, so clamp before narrowing */
+                const float pct = 100.0f * float(busy) / float(std::max<std::int64_t>(total, 1)) + 0.5f;
+                busy_pct[i] = std::uint8_t(std::clamp(pct, 0.0f, 100.0f));
+        }
+}
+
+void
+parse_load(FieldBuffer* field_buffer)
+{
+        /* one minute average, at most four characters like "0.08" or "12.3" */
+        auto& [len, buf] = *field_buffer;
+        const char* space = (const char*)memchr(buf, ' ', len);
+        len = std::min<std::uint32_t>(space != nullptr ? space - buf : len, 4);
+        buf[len] = '\0';
+}
+
+void
+IoAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+        reactor_watch(this, handle);
+}
+
+IoAwaiter
+wait_readable(const int fd, const std::uint64_t deadline_ms)
+{
+        return { fd, POLLIN, deadline_ms };
+}
+
+IoAwaiter
+wait_writable(const int fd, const std::uint64_t deadline_ms)
+{
+        return { fd, POLLOUT, deadline_ms };
+}
+
+IoAwaiter
+sleep_until(const std::uint64_t deadline_ms)
+{
+        return { -1, 0, deadline_ms };
+}
+
+Task<int>
+run_command(const char* cmd, FieldBuffer* field_buffer, const std::uint64_t deadline_ms)
+{
+        auto& [len, buf] = *field_buffer;
+        buf[len = 0] = '\0';
+
+        int pipe_fds[2];
+        int rc = pipe2(pipe_fds, O_CLOEXEC);
+        die(rc < 0, "pipe2");
+
+        /* in its own process group, so a timeout kills the whole pipeline and not just the shell */
+        const pid_t child_pid = create_child(cmd, pipe_fds, true);
+
+        rc = fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+        die(rc < 0, "fcntl");
+
+        /* read until EOF, a full buffer or the deadline */
+        while(len < BUFFER_MAX_SIZE)
+        {
+                const ssize_t n = read(pipe_fds[0], buf + len, BUFFER_MAX_SIZE - len);
+                if(n > 0)
+                {
+                        len += n;
+                        continue;
+                }
+
+                if(n == 0 || (errno != EAGAIN && errno != EINTR))
+                        break;
+
+                if(!co_await wait_readable(pipe_fds[0], deadline_ms))
+                {
+                        kill(-child_pid, SIGKILL);
+                        break;
+                }
+        }
+        close(pipe_fds[0]);
+
+        buf[len] = '\0';
+        if(len > 0 && buf[len - 1] == '\n')
+                buf[--len] = '\0';
+
+        /* reap without blocking the loop, the pidfd becomes readable when the child exits;
+           a shell that closed its output but runs past the deadline is killed with its group too */
+        int status;
+        const int pidfd = syscall(SYS_pidfd_open, child_pid, 0);
+        if(pidfd >= 0)
+        {
+                if(!co_await wait_readable(pidfd, deadline_ms))
+                {
+                        kill(-child_pid, SIGKILL);
+                        co_await wait_readable(pidfd, UINT64_MAX);
+                }
+                close(pidfd);
+                rc = waitpid(child_pid, &status, 0);
+        }
+        else
+        {
+                bool killed = false;
+                while((rc = waitpid(child_pid, &status, WNOHANG)) == 0)
+                {
+                        if(!killed && monotonic_ms() >= deadline_ms)
+                        {
+                                kill(-child_pid, SIGKILL);
+                                killed = true;
+                        }
+                        co_await sleep_until(monotonic_ms() + REAP_POLL_MS);
+                }
+        }
+
+        if(rc < 0)
+                co_return -1;
+
+        co_return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+Task<bool>
+http_get(const char* host, const char* path, FieldBuffer* field_buffer, const std::uint64_t deadline_ms)
+{
+        auto& [len, buf] = *field_buffer;
+        buf[len = 0] = '\0';
+
+        /* resolve asynchronously, getaddrinfo() could stall the loop for seconds */
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        struct gaicb req;
+        memset(&req, 0, sizeof(req));
+        req.ar_name = host;
+        req.ar_service = "80";
+        req.ar_request = &hints;
+
+        struct gaicb* reqs[] = { &req };
+        if(getaddrinfo_a(GAI_NOWAIT, reqs, 1, nullptr) != 0)
+                co_return false;
+
+        while(gai_error(&req) == EAI_INPROGRESS)
+        {
+                /* the resolver thread owns req until it is cancelled or done, so keep waiting otherwise */
+                if(monotonic_ms() >= deadline_ms && gai_cancel(&req) == EAI_CANCELED)
+                        co_return false;
+
+                co_await sleep_until(monotonic_ms() + RESOLVE_POLL_MS);
+        }
+
+        if(gai_error(&req) != 0)
+                co_return false;
+
+        const struct addrinfo* ai = req.ar_result;
+        const int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        int rc = fd < 0 ? -1 : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        freeaddrinfo(req.ar_result);
+
+        if(fd < 0)
+                co_return false;
+
+        bool ok = rc == 0 || errno == EINPROGRESS;
+        if(ok && rc != 0)
+        {
+                int err = 0;
+                socklen_t err_len = sizeof(err);
+                ok = co_await wait_writable(fd, deadline_ms) &&
+                     getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0;
+        }
+
+        /* small enough to go out in one send() on a fresh connection */
+        char request[256];
+        const auto req_res = fmt::format_to_n(
+                                 request,
+                                 sizeof(request),
+                                 "GET {} HTTP/1.0\r\nHost: {}\r\nUser-Agent: curl\r\nConnection: close\r\n\r\n",
+                                 path,
+                                 host
+                             );
+        ok = ok && req_res.size <= sizeof(request) &&
+             send(fd, request, req_res.size, MSG_NOSIGNAL) == ssize_t(req_res.size);
+
+        char response[4096];
+        std::size_t received = 0;
+        while(ok && received < sizeof(response))
+        {
+                const ssize_t n = recv(fd, response + received, sizeof(response) - received, 0);
+                if(n > 0)
+                {
+                        received += n;
+                        continue;
+                }
+
+                if(n == 0)
+                        break;
+
+                ok = (errno == EAGAIN || errno == EINTR) && co_await wait_readable(fd, deadline_ms);
+        }
+        close(fd);
+
+        if(!ok)
+                co_return false;
+
+        /* status line must be 2xx, the body follows the first empty line */
+        const std::string_view resp(response, received);
+        const std::size_t body = resp.find("\r\n\r\n");
+        if(!resp.starts_with("HTTP/") || resp.find(" 2") != resp.find(' ') || body == std::string_view::npos)
+                co_return false;
+
+        const std::string_view content = resp.substr(body + 4, BUFFER_MAX_SIZE);
+        memcpy(buf, content.data(), content.size());
+        buf[len = content.size()] = '\0';
+        if(len > 0 && buf[len - 1] == '\n')
+                buf[--len] = '\0';
+
+        co_return true;
+}
+
+void
+reactor_watch(IoAwaiter* awaiter, std::coroutine_handle<> handle)
+{
+        for(std::size_t i = 0; i < coro_waiters.size(); ++i)
+        {
+                if(coro_waiters[i].awaiter != nullptr)
+                        continue;
+
+                coro_waiters[i] = { awaiter, handle };
+
+                struct pollfd& pfd = pollfds[P_SIZE + i];
+                pfd.fd = awaiter->fd;
+                pfd.events = awaiter->events;
+                pfd.revents = 0;
+
+                return;
+        }
+
+        fmt::print(stderr, "reactor_watch(): More than {} coroutine waiters\n", MAX_CORO_WAITERS);
+        exit(EXIT_FAILURE);
+}
+
+int
+reactor_timeout(const int timeout)
+{
+        std::uint64_t next = UINT64_MAX;
+        for(const auto& w : coro_waiters)
+        {
+                if(w.awaiter != nullptr)
+                        next = std::min(next, w.awaiter->deadline_ms);
+        }
+
+        if(next == UINT64_MAX)
+                return timeout;
+
+        const std::uint64_t now = monotonic_ms();
+        const int wait = next > now ? int(std::min<std::uint64_t>(next - now, INT32_MAX)) : 0;
+
+        return timeout < 0 ? wait : std::min(timeout, wait);
+}
+
+void
+reactor_dispatch()
+{
+        const std::uint64_t now = monotonic_ms();
 
-                break;
-        }
-        case FieldUpdate::Type::Builtin:
+        for(std::size_t i = 0; i < coro_waiters.size(); ++i)
         {
-                auto& args = field_update->args.builtin;
-                args.fptr(args.field_buffer);
+                CoroWaiter w = coro_waiters[i];
+                if(w.awaiter == nullptr)
+                        continue;
 
-                break;
-        }
-        case FieldUpdate::Type::Meta:
-        {
-                auto& args = field_update->args.meta;
-                args.fptr();
+                struct pollfd& pfd = pollfds[P_SIZE + i];
+                const bool ready = pfd.fd >= 0 && pfd.revents != 0;
+                if(!ready && now < w.awaiter->deadline_ms)
+                        continue;
 
-                break;
+                /* free the slot first, the resumed coroutine may wait again right away */
+                coro_waiters[i] = {};
+                pfd.fd = -1;
+                pfd.revents = 0;
+
+                w.awaiter->ready = ready;
+                w.handle.resume();
         }
-        default:
+
+        for(std::size_t i = 0; i < coroutine_states.size(); ++i)
         {
-                DWMSTATUS_UNREACHABLE;
-        }
+                if(coroutine_states[i].running && coroutine_states[i].task.handle.done())
+                        finish_coroutine(i);
         }
 }
 
 void
-toggle_lang(FieldBuffer* field_buffer)
+start_coroutine(const FieldUpdate* field_update, const std::uint64_t received_us)
 {
-        static constexpr std::string_view ltable[2] = {
-            {"US"},
-            {"RO"}
-        };
+        const std::size_t idx = field_update - coroutine_updates.data();
+        CoroutineState& state = coroutine_states[idx];
 
-        static constexpr const char* commands[2] = {
-            "setxkbmap us; setxkbmap -option numpad:mac",
-            "setxkbmap ro -variant std"
-        };
+        /* like pooled builtins, one instance per update at a time */
+        if(state.running)
+        {
+                ++state.reruns;
+                if(received_us != 0 && state.received_us == 0)
+                        state.received_us = received_us;
 
-        static std::size_t idx = 1;
+                return;
+        }
 
-        idx = !idx;
-        std::system(commands[idx]);
+        state.running = true;
+        state.received_us = received_us;
+        state.task = field_update->args.coroutine.coro(&state.scratch);
+        state.task.handle.resume();
 
-        memcpy(field_buffer->data, ltable[idx].data(), 2);
-        field_buffer->length = 2;
+        if(state.task.handle.done())
+                finish_coroutine(idx);
 }
 
 void
-toggle_cpu_gov(FieldBuffer* field_buffer)
+finish_coroutine(const std::size_t idx)
 {
-        static constexpr std::string_view freq_table[2] = {
-            {"*"},
-            {"$"}
-        };
+        CoroutineState& state = coroutine_states[idx];
+        const FieldUpdate* u = &coroutine_updates[idx];
 
-        static constexpr const char* commands[2] = {
-            "xss-set-save",
-            "xss-set-perf"
-        };
+        state.task = Task<>();
+        state.running = false;
 
-        static std::size_t idx = 1;
+        FieldBuffer* field_buffer = u->target();
 
-        idx = !idx;
-        std::system(commands[idx]);
+        /* dropped if a config reload took the field away while the coroutine ran */
+        bool changed = false;
+        if(active_updater(u) == u)
+        {
+                const FieldBuffer old = *field_buffer;
+                *field_buffer = state.scratch;
 
-        memcpy(field_buffer->data, freq_table[idx].data(), 1);
-        field_buffer->length = 1;
+                changed = field_refreshed(u, &old);
+                reschedule_field(u, changed, monotonic_ms());
+        }
+
+        if(changed || state.received_us != 0)
+                update_screen();
+
+        if(state.received_us != 0)
+                record_interactive_latency(std::exchange(state.received_us, 0));
+
+        if(state.reruns > 0)
+        {
+                --state.reruns;
+                start_coroutine(u, 0);
+        }
 }
 
-void
-toggle_mic(FieldBuffer* field_buffer)
+Task<>
+fetch_weather(FieldBuffer* field_buffer)
 {
-        static constexpr std::string_view mic_status_table[2] = {
-            {"0"},
-            {"1"}
-        };
-
-        static constexpr const char* command = "pactl set-source-mute @DEFAULT_SOURCE@ toggle";
+        FieldBuffer body;
+        const bool ok = co_await http_get(WEATHER_HOST, WEATHER_PATH, &body, monotonic_ms() + WEATHER_TIMEOUT_MS);
 
-        static std::size_t idx = 1;
+        /* keep what follows the condition icon, e.g. "+12°C" */
+        auto& [len, buf] = *field_buffer;
+        const std::string_view text(body.data, ok ? body.length : 0);
+        const std::size_t plus = text.find('+');
+        const std::string_view temp = plus != std::string_view::npos ? text.substr(plus) : text;
 
-        idx = !idx;
-        std::system(command);
+        memcpy(buf, temp.data(), temp.size());
+        buf[len = temp.size()] = '\0';
+}
 
-        memcpy(field_buffer->data, mic_status_table[idx].data(), 1);
-        field_buffer->length = 1;
+Task<>
+fetch_temp(FieldBuffer* field_buffer)
+{
+        co_await run_command(TEMP_CMD, field_buffer, monotonic_ms() + TEMP_TIMEOUT_MS);
 }
 
 void
@@ -461,36 +5693,335 @@ init_x()
         }
         screen = DefaultScreen(dpy);
         root = RootWindow(dpy, screen);
+
+        /* both extensions are optional, without them the screen is never considered blanked */
+        int event_base, error_base;
+        if(XScreenSaverQueryExtension(dpy, &event_base, &error_base))
+        {
+                xss_event_base = event_base;
+                XScreenSaverSelectInput(dpy, root, ScreenSaverNotifyMask);
+        }
+
+        have_dpms = DPMSQueryExtension(dpy, &event_base, &error_base) && DPMSCapable(dpy);
+
+        pollfds[P_X].fd = ConnectionNumber(dpy);
+        pollfds[P_X].events = POLLIN;
+
+#ifndef NO_XFT
+        init_font();
+#endif
+#endif
+}
+
+void
+handle_x_events()
+{
+#ifndef NO_X11
+        while(XPending(dpy))
+        {
+                XEvent ev;
+                XNextEvent(dpy, &ev);
+
+                if(xss_event_base >= 0 && ev.type == xss_event_base + ScreenSaverNotify)
+                {
+                        const auto* sev = (const XScreenSaverNotifyEvent*)&ev;
+                        saver_active = sev->state == ScreenSaverOn;
+                        dpms_checked_ms = 0;  /* DPMS usually follows the saver */
+                }
+        }
+#endif
+}
+
+bool
+query_screen_blanked()
+{
+#ifndef NO_X11
+        if(saver_active)
+                return true;
+
+        /* DPMSInfo() is a round trip, the cached level is kept until a saver event or BLANK_CHECK_MS */
+        const std::uint64_t now = monotonic_ms();
+        if(have_dpms && (dpms_checked_ms == 0 || now >= dpms_checked_ms + BLANK_CHECK_MS))
+        {
+                CARD16 level;
+                BOOL enabled;
+                dpms_off = DPMSInfo(dpy, &level, &enabled) && enabled && level != DPMSModeOn;
+                dpms_checked_ms = now;
+        }
+
+        if(dpms_off)
+                return true;
 #endif
+        return false;
+}
+
+bool
+update_blank_state()
+{
+        /* Xlib may have queued events while answering other requests */
+        handle_x_events();
+
+        const bool blanked = query_screen_blanked();
+        if(blanked == screen_blanked)
+                return false;
+
+        screen_blanked = blanked;
+        return true;
+}
+
+void
+catch_up_after_blank()
+{
+        /* one refresh of everything that was suspended, drawn in a single update */
+        const std::uint64_t now = monotonic_ms();
+
+        for(std::size_t i = 0; i < active_periodic.size(); ++i)
+        {
+                if(active_periodic[i].essential || !field_visible(active_periodic[i].field_update))
+                        continue;
+
+                const bool changed = refresh_field(active_periodic[i].field_update);
+                reschedule(i, changed, now);
+        }
+
+        update_screen();
 }
 
 void
 init_statusbar()
 {
-        for(const auto& u : shell_updates)   { run_update(&u); }
-        for(const auto& u : builtin_updates) { run_update(&u); }
+        for(const FieldUpdate* u : field_updaters) { if(u != nullptr && !plugin_owns(u)) run_update(u); }
+        for(std::size_t i = 0; i < plugin_count; ++i) { run_plugin(&plugins[i]); }
+        for(int f = 0; f < R_SIZE; ++f) { field_changed(f); }
         update_screen();
 }
 
+#ifndef NO_XFT
+void
+init_font()
+{
+        bar_font = XftFontOpenName(dpy, screen, BAR_FONT);
+        if(bar_font == nullptr)
+        {
+                fmt::print(stderr, "init_font(): Cannot load font {}, width budget disabled\n", BAR_FONT);
+                return;
+        }
+
+        for(std::uint32_t c = 0; c < glyph_cache.ascii.size(); ++c)
+        {
+                XGlyphInfo info;
+                const FcChar32 glyph = c;
+                XftTextExtents32(dpy, bar_font, &glyph, 1, &info);
+                glyph_cache.ascii[c] = info.xOff;
+        }
+}
+
+std::uint32_t
+glyph_width(const std::uint32_t codepoint)
+{
+        if(codepoint < glyph_cache.ascii.size())
+                return glyph_cache.ascii[codepoint];
+
+        const std::size_t mask = glyph_cache.other.size() - 1;
+        for(std::size_t i = (codepoint * 2654435761u) & mask, probes = 0; probes < glyph_cache.other.size(); i = (i + 1) & mask, ++probes)
+        {
+                GlyphCache::Entry& entry = glyph_cache.other[i];
+                if(entry.codepoint == codepoint)
+                        return entry.width;
+
+                if(entry.codepoint != 0)
+                        continue;
+
+                XGlyphInfo info;
+                const FcChar32 glyph = codepoint;
+                XftTextExtents32(dpy, bar_font, &glyph, 1, &info);
+                entry = { codepoint, std::uint16_t(info.xOff) };
+
+                return entry.width;
+        }
+
+        /* cache full, measure without remembering */
+        XGlyphInfo info;
+        const FcChar32 glyph = codepoint;
+        XftTextExtents32(dpy, bar_font, &glyph, 1, &info);
+
+        return info.xOff;
+}
+
+std::uint32_t
+decode_utf8(const char* data, const std::size_t length, std::size_t* pos)
+{
+        const auto lead = (unsigned char)data[(*pos)++];
+        if(lead < 0x80)
+                return lead;
+
+        const int extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        std::uint32_t codepoint = lead & (0x3F >> extra);
+        for(int k = 0; k < extra && *pos < length && ((unsigned char)data[*pos] & 0xC0) == 0x80; ++k)
+                codepoint = (codepoint << 6) | ((unsigned char)data[(*pos)++] & 0x3F);
+
+        /* invalid sequences are measured as the replacement character */
+        return extra == 0 ? 0xFFFD : codepoint;
+}
+
+std::uint32_t
+text_width(const char* data, const std::size_t length)
+{
+        std::uint32_t width = 0;
+        for(std::size_t pos = 0; pos < length;)
+                width += glyph_width(decode_utf8(data, length, &pos));
+
+        return width;
+}
+
+std::size_t
+fit_length(const char* data, const std::size_t length, const std::uint32_t max_px)
+{
+        std::uint32_t width = 0;
+        for(std::size_t pos = 0; pos < length;)
+        {
+                const std::size_t start = pos;
+                width += glyph_width(decode_utf8(data, length, &pos));
+                if(width > max_px)
+                        return start;
+        }
+
+        return length;
+}
+
+void
+fit_to_budget(std::array<std::uint32_t, R_SIZE>* lengths, std::uint32_t* sparklines_shown)
+{
+        if(literal_width_dirty)
+        {
+                const RenderPlan::Segment& last = render_plan.segments[render_plan.segment_count - 1];
+                literal_width_px = text_width(render_plan.literals.data(), last.literal_offset + last.literal_length);
+                literal_width_dirty = false;
+        }
+
+        /* only fields that changed since the last draw are measured again */
+        std::uint32_t total = literal_width_px;
+        std::array<int, R_SIZE> order;
+        std::size_t count = 0;
+
+        for(std::size_t i = 0; i + 1 < render_plan.segment_count; ++i)
+        {
+                const int f = render_plan.segments[i].field;
+                if(dirty_widths & (1u << f))
+                {
+                        field_widths[f] = text_width(field_buffers[f].data, (*lengths)[f]);
+                        if(sparkline_rows[f] >= 0 && sparkline_history.count[sparkline_rows[f]] > 0)
+                                field_widths[f] += glyph_width(' ') + text_width(sparkline_history.glyphs[sparkline_rows[f]].data(),
+                                                                                 sparkline_history.count[sparkline_rows[f]] * 3);
+                }
+
+                total += field_widths[f];
+                order[count++] = f;
+        }
+
+        dirty_widths = 0;
+        if(total <= width_budget_px)
+                return;
+
+        /* lowest priority first, and right to left among equals since that is where dwm would cut */
+        std::stable_sort(order.begin(), order.begin() + count, [](const int a, const int b)
+        {
+                const int pa = active_layout->fields[a].priority;
+                const int pb = active_layout->fields[b].priority;
+                return pa != pb ? pa < pb : a > b;
+        });
+
+        for(std::size_t k = 0; k < count && total > width_budget_px; ++k)
+        {
+                const int f = order[k];
+                const std::uint32_t overflow = total - width_budget_px;
+
+                if(field_widths[f] <= overflow)
+                {
+                        total -= field_widths[f];
+                        (*lengths)[f] = 0;
+                        continue;
+                }
+
+                /* a cut field drops its sparkline first */
+                (*lengths)[f] = fit_length(field_buffers[f].data, (*lengths)[f], field_widths[f] - overflow);
+                *sparklines_shown &= ~(1u << f);
+                total = width_budget_px;
+        }
+}
+#endif
+
+std::size_t
+capped_length(const FieldBuffer& field_buffer, const std::uint32_t max_width)
+{
+        /* counts UTF-8 lead bytes so a multi-byte character is never cut in half */
+        std::uint32_t chars = 0;
+        for(std::size_t i = 0; i < field_buffer.length; ++i)
+        {
+                if((field_buffer.data[i] & 0xC0) != 0x80 && chars++ == max_width)
+                        return i;
+        }
+
+        return field_buffer.length;
+}
+
 void
 update_screen()
 {
         char buffer[ROOT_BUFFER_MAX_SIZE + 1];
+        char* out = buffer;
 
-        const auto res = std::apply(
-            [&](auto&&... args)
-            {
-                    return fmt::format_to_n(
-                               buffer,
-                               ROOT_BUFFER_MAX_SIZE,
-                               STATUS_FMT,
-                               std::string_view(args.data, args.length)...
-                           );
-            },
-            field_buffers
-        );
+        std::array<std::uint32_t, R_SIZE> lengths;
+        for(std::size_t i = 0; i + 1 < render_plan.segment_count; ++i)
+        {
+                const RenderPlan::Segment& seg = render_plan.segments[i];
+                const FieldBuffer& field_buffer = field_buffers[seg.field];
+                lengths[seg.field] = seg.max_width > 0 ? capped_length(field_buffer, seg.max_width) : field_buffer.length;
+        }
 
-        *res.out = '\0';
+        std::uint32_t sparklines_shown = ALL_FIELDS;
+#ifndef NO_XFT
+        if(width_budget_px > 0 && bar_font != nullptr)
+                fit_to_budget(&lengths, &sparklines_shown);
+#endif
+
+        /* literals and fields together never exceed ROOT_BUFFER_MAX_SIZE */
+        for(std::size_t i = 0; i < render_plan.segment_count; ++i)
+        {
+                const RenderPlan::Segment& seg = render_plan.segments[i];
+                memcpy(out, render_plan.literals.data() + seg.literal_offset, seg.literal_length);
+                out += seg.literal_length;
+
+                if(seg.field < 0)
+                        break;
+
+                /* escapes are prebuilt, styling a field is two more copies */
+                const int style = lengths[seg.field] > 0 ? field_styles[seg.field] : -1;
+                if(style >= 0)
+                {
+                        memcpy(out, style_escapes[style].data, style_escapes[style].length);
+                        out += style_escapes[style].length;
+                }
+
+                memcpy(out, field_buffers[seg.field].data, lengths[seg.field]);
+                out += lengths[seg.field];
+
+                const int row = sparkline_rows[seg.field];
+                if(row >= 0 && lengths[seg.field] > 0 && (sparklines_shown & (1u << seg.field)))
+                {
+                        *out++ = ' ';
+                        memcpy(out, sparkline_history.glyphs[row].data(), sparkline_history.count[row] * 3);
+                        out += sparkline_history.count[row] * 3;
+                }
+
+                if(style >= 0)
+                {
+                        memcpy(out, STYLE_RESET, 3);
+                        out += 3;
+                }
+        }
+
+        *out = '\0';
 
 #ifndef NO_X11
         XStoreName(dpy, root, buffer);
@@ -501,49 +6032,42 @@ update_screen()
 }
 
 void
-handle_received(const std::uint32_t id)
+handle_received(const std::uint32_t id, const std::uint64_t received_us)
 {
-        if(id >= real_time_updates.size())
+        if(id >= active_real_time.size() || active_real_time[id].field_update == nullptr)
         {
                 fmt::print(
                     stderr,
                     "handle_received(): Received id out of bounds: {}. Size is: {}.\n",
                     id,
-                    real_time_updates.size()
+                    active_real_time.size()
                 );
 
                 return;
         }
 
-        run_update(real_time_updates[id]);
-        update_screen();
-}
+        const RealTimeUpdate& u = active_real_time[id];
+        RequestQueue* queue = u.priority == RealTimeUpdate::Interactive ? &interactive_queue : &background_queue;
 
-void DWMSTATUS_NORETURN
-cleanup_and_exit(const int)
-{
-        unlink(SOCKET_PATH);
-        _exit(EXIT_SUCCESS);
+        if(!queue_push(queue, { id, received_us }))
+                fmt::print(stderr, "handle_received(): Queue full, dropping id {}\n", id);
 }
 
 void
-run()
+drain_socket()
 {
-        const int sock_fd = get_named_socket();
-
-        init_signals();
-        init_x();
-        init_statusbar();
-
-        while(running)
+        for(;;)
         {
                 std::uint32_t id;
 
-                const auto rc = read(sock_fd, &id, sizeof(id));
+                const auto rc = recv(pollfds[P_SOCK].fd, &id, sizeof(id), MSG_DONTWAIT);
                 if(rc < 0)
                 {
+                        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                                return;
+
                         unlink(SOCKET_PATH);
-                        perror_exit("read");
+                        perror_exit("recv");
                 }
 
                 if(rc != sizeof(id))
@@ -557,10 +6081,92 @@ run()
                 }
                 else
                 {
-                        handle_received(id);
+                        handle_received(id, monotonic_us());
+                }
+        }
+}
+
+void DWMSTATUS_NORETURN
+cleanup_and_exit(const int)
+{
+        unlink(SOCKET_PATH);
+        _exit(EXIT_SUCCESS);
+}
+
+void
+run()
+{
+        const int sock_fd = get_named_socket();
+
+        for(auto& pfd : pollfds)
+                pfd.fd = -1;
+
+        pollfds[P_SOCK].fd = sock_fd;
+        pollfds[P_SOCK].events = POLLIN;
+
+        init_signals();
+        init_x();
+        init_uring();
+        load_plugins();
+        init_config();
+        init_netlink();
+        init_psi();
+        init_block_devices();
+        update_visibility(true);
+        init_statusbar();
+        init_power();
+        init_clock_watch();
+        init_pool();
+        init_scheduler();
+
+        while(running)
+        {
+                const int timeout = reactor_timeout(run_scheduler());
+
+                const int prc = poll(pollfds.data(), pollfds.size(), timeout);
+                if(prc < 0 && errno != EINTR)
+                {
+                        unlink(SOCKET_PATH);
+                        perror_exit("poll");
                 }
+
+                ++stats.wakeups;
+
+                if(prc < 0)
+                        continue;
+
+                if(pollfds[P_X].revents & POLLIN)
+                        handle_x_events();
+
+                if(pollfds[P_CLOCK].revents & POLLIN)
+                        handle_clock_timer();
+
+                if(pollfds[P_TZ].revents & POLLIN)
+                        handle_tz_events();
+
+                if(pollfds[P_CONFIG].revents & POLLIN)
+                        handle_config_events();
+
+                if(pollfds[P_NETLINK].revents & POLLIN)
+                        handle_netlink_events();
+
+                if((pollfds[P_PSI_CPU].revents | pollfds[P_PSI_MEMORY].revents | pollfds[P_PSI_IO].revents) & (POLLPRI | POLLERR | POLLNVAL))
+                        handle_psi_events();
+
+                if(pollfds[P_POOL].revents & POLLIN)
+                        drain_pool_results();
+
+                if(pollfds[P_SOCK].revents & POLLIN)
+                        drain_socket();
+
+                handle_plugin_events();
+
+                /* resumes coroutines whose fd became ready or whose deadline passed */
+                reactor_dispatch();
         }
 
+        stop_pool();
+        unload_plugins();
         close(sock_fd);
         unlink(SOCKET_PATH);
 }